@@ -0,0 +1,104 @@
+#include "acpi.hpp"
+
+#include <string.h>
+
+namespace
+{
+    using namespace bitnos::acpi;
+
+    const EFI_GUID kAcpi20TableGuid = {
+        0x8868e871, 0xe4f1, 0x11d3,
+        {0xbc, 0x22, 0x00, 0x80, 0xc7, 0x3c, 0x88, 0x81}
+    };
+
+    const DescriptionHeader* xsdt = nullptr;
+
+    uint8_t Sum(const void* data, size_t bytes)
+    {
+        auto p = reinterpret_cast<const uint8_t*>(data);
+        uint8_t sum = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            sum += p[i];
+        }
+        return sum;
+    }
+
+    bool IsValid(const RSDP& rsdp)
+    {
+        return memcmp(rsdp.signature, "RSD PTR ", sizeof(rsdp.signature)) == 0
+            && rsdp.revision >= 2
+            && Sum(&rsdp, 20) == 0
+            && Sum(&rsdp, sizeof(RSDP)) == 0;
+    }
+
+    bool IsValid(const DescriptionHeader& header, const char* signature)
+    {
+        return memcmp(header.signature, signature, sizeof(header.signature)) == 0
+            && Sum(&header, header.length) == 0;
+    }
+
+    size_t NumEntries(const DescriptionHeader& xsdt)
+    {
+        return (xsdt.length - sizeof(DescriptionHeader)) / sizeof(uint64_t);
+    }
+
+    const DescriptionHeader* Entry(const DescriptionHeader& xsdt, size_t index)
+    {
+        // entries are 8 bytes but only 4 byte aligned
+        uint64_t addr;
+        memcpy(&addr,
+            reinterpret_cast<const uint8_t*>(&xsdt) + sizeof(DescriptionHeader)
+                + sizeof(uint64_t) * index,
+            sizeof(addr));
+        return reinterpret_cast<const DescriptionHeader*>(addr);
+    }
+}
+
+namespace bitnos::acpi
+{
+    Error Initialize(const BootParam& param)
+    {
+        auto system_table = param.efi_system_table;
+        const RSDP* rsdp = nullptr;
+        for (UINTN i = 0; i < system_table->NumberOfTableEntries; ++i)
+        {
+            const auto& table = system_table->ConfigurationTable[i];
+            if (memcmp(&table.VendorGuid, &kAcpi20TableGuid, sizeof(EFI_GUID)) == 0)
+            {
+                rsdp = reinterpret_cast<const RSDP*>(table.VendorTable);
+                break;
+            }
+        }
+        if (rsdp == nullptr || !IsValid(*rsdp))
+        {
+            return errorcode::kNotFound;
+        }
+
+        auto header = reinterpret_cast<const DescriptionHeader*>(rsdp->xsdt_address);
+        if (!IsValid(*header, "XSDT"))
+        {
+            return errorcode::kNotFound;
+        }
+        xsdt = header;
+        return errorcode::kSuccess;
+    }
+
+    const DescriptionHeader* FindTable(const char* signature)
+    {
+        if (xsdt == nullptr)
+        {
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < NumEntries(*xsdt); ++i)
+        {
+            auto table = Entry(*xsdt, i);
+            if (IsValid(*table, signature))
+            {
+                return table;
+            }
+        }
+        return nullptr;
+    }
+}
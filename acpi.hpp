@@ -0,0 +1,166 @@
+#ifndef ACPI_HPP_
+#define ACPI_HPP_
+
+/** @file acpi.hpp finds ACPI tables through the EFI configuration table.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bootparam.h"
+#include "errorcode.hpp"
+
+namespace bitnos::acpi
+{
+    struct RSDP
+    {
+        char signature[8];
+        uint8_t checksum;
+        char oem_id[6];
+        uint8_t revision;
+        uint32_t rsdt_address;
+        uint32_t length;
+        uint64_t xsdt_address;
+        uint8_t extended_checksum;
+        char reserved[3];
+    } __attribute__((__packed__));
+
+    struct DescriptionHeader
+    {
+        char signature[4];
+        uint32_t length;
+        uint8_t revision;
+        uint8_t checksum;
+        char oem_id[6];
+        char oem_table_id[8];
+        uint32_t oem_revision;
+        uint32_t creator_id;
+        uint32_t creator_revision;
+    } __attribute__((__packed__));
+
+    /** @brief MADT (signature "APIC") lists the interrupt controllers.
+     * Variable length entries follow the fixed part.
+     */
+    struct MADT
+    {
+        DescriptionHeader header;
+        uint32_t lapic_address;
+        uint32_t flags; // bit 0: 8259 pair installed
+    } __attribute__((__packed__));
+
+    enum MadtEntryType : uint8_t
+    {
+        kMadtLocalApic = 0,
+        kMadtIoApic = 1,
+        kMadtInterruptOverride = 2,
+        kMadtLocalApicAddressOverride = 5,
+        kMadtLocalX2Apic = 9,
+    };
+
+    struct MadtEntry
+    {
+        uint8_t type;
+        uint8_t length;
+    } __attribute__((__packed__));
+
+    struct MadtLocalApic
+    {
+        MadtEntry entry;
+        uint8_t processor_id;
+        uint8_t apic_id;
+        uint32_t flags; // bit 0: enabled
+    } __attribute__((__packed__));
+
+    struct MadtIoApic
+    {
+        MadtEntry entry;
+        uint8_t id;
+        uint8_t reserved;
+        uint32_t address;
+        uint32_t gsi_base;
+    } __attribute__((__packed__));
+
+    /** @brief MadtInterruptOverride maps an ISA IRQ to another GSI.
+     *
+     * flags bits 0-1: polarity (0 bus default, 1 high, 3 low),
+     * bits 2-3: trigger mode (0 bus default, 1 edge, 3 level).
+     */
+    struct MadtInterruptOverride
+    {
+        MadtEntry entry;
+        uint8_t bus;
+        uint8_t source;
+        uint32_t gsi;
+        uint16_t flags;
+    } __attribute__((__packed__));
+
+    struct MadtLocalApicAddressOverride
+    {
+        MadtEntry entry;
+        uint16_t reserved;
+        uint64_t address;
+    } __attribute__((__packed__));
+
+    struct MadtLocalX2Apic
+    {
+        MadtEntry entry;
+        uint16_t reserved;
+        uint32_t x2apic_id;
+        uint32_t flags;
+        uint32_t processor_uid;
+    } __attribute__((__packed__));
+
+    struct GenericAddress
+    {
+        uint8_t space_id; // 0: memory, 1: I/O port
+        uint8_t bit_width;
+        uint8_t bit_offset;
+        uint8_t access_size;
+        uint64_t address;
+    } __attribute__((__packed__));
+
+    /** @brief HPET (signature "HPET") locates the event timer block.
+     */
+    struct HPET
+    {
+        DescriptionHeader header;
+        uint32_t event_timer_block_id;
+        GenericAddress base_address;
+        uint8_t hpet_number;
+        uint16_t minimum_tick;
+        uint8_t page_protection;
+    } __attribute__((__packed__));
+
+    /** @brief Initialize finds and validates the RSDP and the XSDT.
+     *
+     * @return kNotFound if the firmware provides no ACPI 2.0 tables.
+     */
+    Error Initialize(const BootParam& param);
+
+    /** @brief FindTable returns the first table with signature,
+     * or nullptr if there is none.
+     */
+    const DescriptionHeader* FindTable(const char* signature);
+
+    /** @brief ForEachMadtEntry calls func with each entry of madt.
+     */
+    template <typename Func>
+    void ForEachMadtEntry(const MADT& madt, Func func)
+    {
+        auto p = reinterpret_cast<const uint8_t*>(&madt);
+        auto end = p + madt.header.length;
+        p += sizeof(MADT);
+        while (p + sizeof(MadtEntry) <= end)
+        {
+            auto entry = reinterpret_cast<const MadtEntry*>(p);
+            if (entry->length < sizeof(MadtEntry) || p + entry->length > end)
+            {
+                break;
+            }
+            func(*entry);
+            p += entry->length;
+        }
+    }
+}
+
+#endif // ACPI_HPP_
@@ -0,0 +1,319 @@
+#include "apic.hpp"
+
+#include "acpi.hpp"
+#include "asmfunc.h"
+#include "paging.hpp"
+
+namespace
+{
+    using namespace bitnos;
+    using namespace bitnos::apic;
+
+    const uint32_t kMsrApicBase = 0x1b;
+    const uint64_t kApicBaseEnable = 1u << 11;
+    const uint64_t kApicBaseX2Apic = 1u << 10;
+    const uint32_t kMsrX2ApicBase = 0x800;
+    const uint32_t kSvrEnable = 1u << 8;
+
+    // I/O APIC registers
+    const uint32_t kIoRegSel = 0x00;
+    const uint32_t kIoWin = 0x10;
+    const uint8_t kIoApicVersion = 0x01;
+    const uint8_t kIoRedirectionTable = 0x10;
+
+    const uint32_t kRteActiveLow = 1u << 13;
+    const uint32_t kRteLevel = 1u << 15;
+    const uint32_t kRteMasked = 1u << 16;
+
+    struct IoApic
+    {
+        uintptr_t base;
+        uint32_t gsi_base;
+        uint32_t num_entries;
+    };
+
+    struct IsaIrq
+    {
+        uint32_t gsi;
+        uint16_t flags; // as in acpi::MadtInterruptOverride
+    };
+
+    const int kMaxIoApics = 8;
+    const int kNumIsaIrqs = 16;
+
+    Mode mode = Mode::kDisabled;
+    uintptr_t lapic_base = 0;
+    IoApic io_apics[kMaxIoApics];
+    int num_io_apics = 0;
+    IsaIrq isa_irqs[kNumIsaIrqs];
+
+    uint32_t ReadIoApic(const IoApic& io_apic, uint8_t index)
+    {
+        *reinterpret_cast<volatile uint32_t*>(io_apic.base + kIoRegSel) = index;
+        return *reinterpret_cast<volatile uint32_t*>(io_apic.base + kIoWin);
+    }
+
+    void WriteIoApic(const IoApic& io_apic, uint8_t index, uint32_t value)
+    {
+        *reinterpret_cast<volatile uint32_t*>(io_apic.base + kIoRegSel) = index;
+        *reinterpret_cast<volatile uint32_t*>(io_apic.base + kIoWin) = value;
+    }
+
+    void WriteRedirection(const IoApic& io_apic, uint32_t pin, uint32_t low, uint32_t high)
+    {
+        const uint8_t index = kIoRedirectionTable + 2 * pin;
+        // mask first so that the entry is never live half written
+        WriteIoApic(io_apic, index, kRteMasked);
+        WriteIoApic(io_apic, index + 1, high);
+        WriteIoApic(io_apic, index, low);
+    }
+
+    IoApic* FindIoApic(uint32_t gsi)
+    {
+        for (int i = 0; i < num_io_apics; ++i)
+        {
+            auto& io_apic = io_apics[i];
+            if (io_apic.gsi_base <= gsi && gsi < io_apic.gsi_base + io_apic.num_entries)
+            {
+                return &io_apic;
+            }
+        }
+        return nullptr;
+    }
+
+    /*
+     * RouteGsi programs the entry of gsi. Bus default polarity and trigger
+     * mode in flags are replaced by the given defaults.
+     */
+    Error RouteGsi(uint32_t gsi, uint16_t flags, bool default_level, bool default_low,
+                   uint8_t vector, uint32_t dest)
+    {
+        auto io_apic = FindIoApic(gsi);
+        if (io_apic == nullptr)
+        {
+            return errorcode::kNotFound;
+        }
+        if (dest > 0xff || vector < 0x20)
+        {
+            // wider IDs need interrupt remapping
+            return errorcode::kInvalidValue;
+        }
+
+        const auto polarity = flags & 0x3u;
+        const auto trigger = (flags >> 2) & 0x3u;
+        const bool low = polarity == 0 ? default_low : polarity == 3;
+        const bool level = trigger == 0 ? default_level : trigger == 3;
+
+        // fixed delivery to a physical destination
+        uint32_t low_dword = vector;
+        if (low)
+        {
+            low_dword |= kRteActiveLow;
+        }
+        if (level)
+        {
+            low_dword |= kRteLevel;
+        }
+        WriteRedirection(*io_apic, gsi - io_apic->gsi_base, low_dword, dest << 24);
+        return errorcode::kSuccess;
+    }
+
+    void MaskLegacyPic()
+    {
+        // remap first so that a spurious IRQ doesn't look like an exception
+        IoOut8(0x21, 0xff);
+        IoOut8(0xa1, 0xff);
+        IoOut8(0x20, 0x11);
+        IoOut8(0x21, 0x20);
+        IoOut8(0x21, 1 << 2);
+        IoOut8(0x21, 0x01);
+        IoOut8(0xa0, 0x11);
+        IoOut8(0xa1, 0x28);
+        IoOut8(0xa1, 2);
+        IoOut8(0xa1, 0x01);
+        IoOut8(0x21, 0xff);
+        IoOut8(0xa1, 0xff);
+    }
+
+    void ReadMadt(const acpi::MADT& madt)
+    {
+        lapic_base = madt.lapic_address;
+        num_io_apics = 0;
+        for (int i = 0; i < kNumIsaIrqs; ++i)
+        {
+            isa_irqs[i] = {static_cast<uint32_t>(i), 0};
+        }
+
+        acpi::ForEachMadtEntry(madt, [](const acpi::MadtEntry& entry)
+            {
+                switch (entry.type)
+                {
+                case acpi::kMadtIoApic:
+                    if (num_io_apics < kMaxIoApics)
+                    {
+                        auto& e = reinterpret_cast<const acpi::MadtIoApic&>(entry);
+                        io_apics[num_io_apics++] = {e.address, e.gsi_base, 0};
+                    }
+                    break;
+                case acpi::kMadtInterruptOverride:
+                    {
+                        auto& e = reinterpret_cast<const acpi::MadtInterruptOverride&>(entry);
+                        if (e.bus == 0 && e.source < kNumIsaIrqs)
+                        {
+                            isa_irqs[e.source] = {e.gsi, e.flags};
+                        }
+                    }
+                    break;
+                case acpi::kMadtLocalApicAddressOverride:
+                    lapic_base = reinterpret_cast<const acpi::MadtLocalApicAddressOverride&>(
+                        entry).address;
+                    break;
+                }
+            });
+    }
+}
+
+namespace bitnos::apic
+{
+    Error Initialize()
+    {
+        auto madt = reinterpret_cast<const acpi::MADT*>(acpi::FindTable("APIC"));
+        if (madt == nullptr)
+        {
+            return errorcode::kNotFound;
+        }
+        ReadMadt(*madt);
+        if (num_io_apics == 0)
+        {
+            return errorcode::kNotFound;
+        }
+
+        if (madt->flags & 1u)
+        {
+            MaskLegacyPic();
+        }
+
+        for (int i = 0; i < num_io_apics; ++i)
+        {
+            auto& io_apic = io_apics[i];
+            auto err = paging::MapMmio(io_apic.base, kIoWin + 4);
+            if (IsError(err))
+            {
+                return err;
+            }
+            io_apic.num_entries = ((ReadIoApic(io_apic, kIoApicVersion) >> 16) & 0xffu) + 1;
+            for (uint32_t pin = 0; pin < io_apic.num_entries; ++pin)
+            {
+                WriteRedirection(io_apic, pin, kRteMasked, 0);
+            }
+        }
+
+        uint32_t regs[4];
+        CpuId(1, 0, regs);
+        const bool has_x2apic = regs[2] & (1u << 21);
+
+        auto apic_base = ReadMSR(kMsrApicBase) | kApicBaseEnable;
+        if (has_x2apic)
+        {
+            apic_base |= kApicBaseX2Apic;
+            WriteMSR(kMsrApicBase, apic_base);
+            mode = Mode::kX2Apic;
+        }
+        else
+        {
+            WriteMSR(kMsrApicBase, apic_base);
+            auto err = paging::MapMmio(lapic_base, 0x400);
+            if (IsError(err))
+            {
+                return err;
+            }
+            mode = Mode::kXApic;
+        }
+
+        WriteLapic(kLapicTpr, 0);
+        WriteLapic(kLapicLvtLint0, kLvtMasked);
+        WriteLapic(kLapicLvtError, kLvtMasked);
+        WriteLapic(kLapicSvr, kSvrEnable | kSpuriousVector);
+        return errorcode::kSuccess;
+    }
+
+    Mode LapicMode()
+    {
+        return mode;
+    }
+
+    uint32_t ReadLapic(LapicRegister reg)
+    {
+        if (mode == Mode::kX2Apic)
+        {
+            return ReadMSR(kMsrX2ApicBase + reg / 16);
+        }
+        return *reinterpret_cast<volatile uint32_t*>(lapic_base + reg);
+    }
+
+    void WriteLapic(LapicRegister reg, uint32_t value)
+    {
+        if (mode == Mode::kX2Apic)
+        {
+            WriteMSR(kMsrX2ApicBase + reg / 16, value);
+            return;
+        }
+        *reinterpret_cast<volatile uint32_t*>(lapic_base + reg) = value;
+    }
+
+    uint32_t LapicId()
+    {
+        const auto id = ReadLapic(kLapicId);
+        return mode == Mode::kX2Apic ? id : id >> 24;
+    }
+
+    void EndOfInterrupt()
+    {
+        WriteLapic(kLapicEoi, 0);
+    }
+
+    Error RouteIsaIrq(uint8_t irq, uint8_t vector, uint32_t dest)
+    {
+        if (irq >= kNumIsaIrqs)
+        {
+            return errorcode::kIndexOutOfRange;
+        }
+        const auto& isa_irq = isa_irqs[irq];
+        return RouteGsi(isa_irq.gsi, isa_irq.flags, false, false, vector, dest);
+    }
+
+    Error RoutePciInterrupt(pci::Device& device, uint8_t vector, uint32_t dest)
+    {
+        const auto reg = device.ReadConfReg(0x3c);
+        const uint8_t line = reg & 0xffu;
+        const uint8_t pin = (reg >> 8) & 0xffu;
+        if (pin == 0)
+        {
+            return errorcode::kInvalidValue;
+        }
+        if (line >= kNumIsaIrqs)
+        {
+            return errorcode::kNotFound;
+        }
+
+        // PCI interrupts are level triggered, active low
+        const auto& isa_irq = isa_irqs[line];
+        return RouteGsi(isa_irq.gsi, isa_irq.flags, true, true, vector, dest);
+    }
+
+    Error MaskIsaIrq(uint8_t irq)
+    {
+        if (irq >= kNumIsaIrqs)
+        {
+            return errorcode::kIndexOutOfRange;
+        }
+        const auto gsi = isa_irqs[irq].gsi;
+        auto io_apic = FindIoApic(gsi);
+        if (io_apic == nullptr)
+        {
+            return errorcode::kNotFound;
+        }
+        WriteRedirection(*io_apic, gsi - io_apic->gsi_base, kRteMasked, 0);
+        return errorcode::kSuccess;
+    }
+}
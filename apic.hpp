@@ -0,0 +1,85 @@
+#ifndef APIC_HPP_
+#define APIC_HPP_
+
+/** @file apic.hpp drives the local APIC and the I/O APICs listed in the
+ * ACPI MADT. acpi::Initialize must succeed before apic::Initialize.
+ */
+
+#include <stdint.h>
+
+#include "errorcode.hpp"
+#include "pci.hpp"
+
+namespace bitnos::apic
+{
+    /** Offsets of the xAPIC MMIO registers. In x2APIC mode register
+     * offset is accessed as MSR 0x800 + offset / 16.
+     */
+    enum LapicRegister : uint32_t
+    {
+        kLapicId = 0x020,
+        kLapicVersion = 0x030,
+        kLapicTpr = 0x080,
+        kLapicEoi = 0x0b0,
+        kLapicSvr = 0x0f0,
+        kLapicLvtTimer = 0x320,
+        kLapicLvtLint0 = 0x350,
+        kLapicLvtLint1 = 0x360,
+        kLapicLvtError = 0x370,
+        kLapicInitialCount = 0x380,
+        kLapicCurrentCount = 0x390,
+        kLapicDivideConfig = 0x3e0,
+    };
+
+    const uint32_t kLvtMasked = 1u << 16;
+    const uint8_t kSpuriousVector = 0xff;
+
+    enum class Mode
+    {
+        kDisabled,
+        kXApic,
+        kX2Apic,
+    };
+
+    /** @brief Initialize enables the local APIC, in x2APIC mode if the CPU
+     * supports it, masks every I/O APIC input and the 8259 pair.
+     *
+     * @return kNotFound if there is no MADT or it lists no I/O APIC.
+     */
+    Error Initialize();
+
+    Mode LapicMode();
+    uint32_t ReadLapic(LapicRegister reg);
+    void WriteLapic(LapicRegister reg, uint32_t value);
+
+    /** @brief LapicId returns the APIC ID of the running CPU.
+     */
+    uint32_t LapicId();
+
+    /** @brief EndOfInterrupt signals the end of a fixed interrupt.
+     * It is a single MMIO store, or a single WRMSR in x2APIC mode.
+     */
+    void EndOfInterrupt();
+
+    /** @brief RouteIsaIrq delivers an ISA IRQ to vector on the CPU whose
+     * APIC ID is dest. Interrupt source overrides of the MADT apply.
+     */
+    Error RouteIsaIrq(uint8_t irq, uint8_t vector, uint32_t dest);
+
+    /** @brief RoutePciInterrupt delivers the INTx pin of device to vector on
+     * the CPU whose APIC ID is dest.
+     *
+     * Without an AML interpreter the _PRT can't be read, so the IRQ the
+     * firmware wrote to Interrupt Line is used, as on PIIX chipsets.
+     *
+     * @return kInvalidValue if device has no INTx pin, kNotFound if
+     *   the firmware assigned no IRQ.
+     */
+    Error RoutePciInterrupt(pci::Device& device, uint8_t vector, uint32_t dest);
+
+    /** @brief MaskIsaIrq stops delivery of an ISA IRQ.
+     */
+    Error MaskIsaIrq(uint8_t irq);
+}
+
+#endif // APIC_HPP_
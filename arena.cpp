@@ -0,0 +1,113 @@
+#include "arena.hpp"
+
+#include "bitutil.hpp"
+#include "memory.hpp"
+
+namespace bitnos::memory
+{
+    Arena::Arena(size_t frames_per_chunk)
+        : frames_per_chunk_(frames_per_chunk),
+          used_head_(nullptr), used_tail_(nullptr), spare_(nullptr),
+          cur_(0), end_(0), bytes_allocated_(0)
+    {}
+
+    Arena::~Arena()
+    {
+        Reset();
+        if (spare_)
+        {
+            FreeChunk(spare_);
+        }
+    }
+
+    void Arena::FreeChunk(Chunk* chunk)
+    {
+        frame_allocator->FreeFrames(
+            reinterpret_cast<uintptr_t>(chunk), chunk->num_frames);
+    }
+
+    Arena::Chunk* Arena::NewChunk(size_t min_bytes)
+    {
+        const size_t bytes = sizeof(Chunk) + min_bytes;
+        if (spare_ && spare_->num_frames * kBytesPerFrame >= bytes)
+        {
+            auto chunk = spare_;
+            spare_ = chunk->next;
+            return chunk;
+        }
+
+        size_t num_frames = (bytes + kBytesPerFrame - 1) / kBytesPerFrame;
+        num_frames = num_frames < frames_per_chunk_ ? frames_per_chunk_ : num_frames;
+        auto mem = frame_allocator->AllocateFrames(num_frames);
+        if (IsError(mem.error))
+        {
+            return nullptr;
+        }
+        auto chunk = reinterpret_cast<Chunk*>(mem.value);
+        chunk->num_frames = num_frames;
+        return chunk;
+    }
+
+    void* Arena::Allocate(size_t size, size_t align)
+    {
+        uintptr_t p = bitutil::ClearBits(cur_ + align - 1, align - 1);
+        if (cur_ == 0 || p + size > end_)
+        {
+            auto chunk = NewChunk(size + align);
+            if (chunk == nullptr)
+            {
+                return nullptr;
+            }
+            chunk->next = nullptr;
+            if (used_tail_)
+            {
+                used_tail_->next = chunk;
+            }
+            else
+            {
+                used_head_ = chunk;
+            }
+            used_tail_ = chunk;
+
+            cur_ = reinterpret_cast<uintptr_t>(chunk + 1);
+            end_ = reinterpret_cast<uintptr_t>(chunk)
+                + chunk->num_frames * kBytesPerFrame;
+            p = bitutil::ClearBits(cur_ + align - 1, align - 1);
+        }
+
+        cur_ = p + size;
+        bytes_allocated_ += size;
+        return reinterpret_cast<void*>(p);
+    }
+
+    void Arena::Reset()
+    {
+        if (used_head_)
+        {
+            used_tail_->next = spare_;
+            spare_ = used_head_;
+        }
+
+        // keep one regular chunk; the rest and dedicated ones go back
+        Chunk* keep = nullptr;
+        for (auto chunk = spare_; chunk != nullptr;)
+        {
+            auto next = chunk->next;
+            if (keep == nullptr && chunk->num_frames == frames_per_chunk_)
+            {
+                keep = chunk;
+                keep->next = nullptr;
+            }
+            else
+            {
+                FreeChunk(chunk);
+            }
+            chunk = next;
+        }
+        spare_ = keep;
+
+        used_head_ = used_tail_ = nullptr;
+        cur_ = end_ = 0;
+        bytes_allocated_ = 0;
+    }
+}
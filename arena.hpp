@@ -0,0 +1,67 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+/** @file arena.hpp provides a bump-pointer allocator for short-lived
+ * scratch memory, such as memory used during one shell command.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bitnos::memory
+{
+    /** @brief Arena allocates memory by bumping a pointer in chunks of frames.
+     *
+     * Individual allocations are never freed. Reset releases everything
+     * at once and keeps one regular chunk for later use, giving the others
+     * back to frame_allocator so that one large use does not pin its peak.
+     * The last chunk goes back when the arena is destroyed.
+     */
+    class Arena
+    {
+        struct Chunk
+        {
+            Chunk* next;
+            size_t num_frames;
+        };
+
+        const size_t frames_per_chunk_;
+        Chunk* used_head_;
+        Chunk* used_tail_;
+        Chunk* spare_;
+        uintptr_t cur_, end_;
+        size_t bytes_allocated_;
+
+        Chunk* NewChunk(size_t min_bytes);
+        void FreeChunk(Chunk* chunk);
+
+    public:
+        /**
+         * @param frames_per_chunk  Size of a chunk in frames. Allocations
+         *   larger than a chunk get a dedicated chunk.
+         */
+        Arena(size_t frames_per_chunk = 1);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator =(const Arena&) = delete;
+
+        /** @brief Allocate returns size bytes aligned to align
+         * (power of two), or nullptr if out of memory.
+         */
+        void* Allocate(size_t size, size_t align = 16);
+
+        template <typename T>
+        T* AllocateArray(size_t n)
+        {
+            return reinterpret_cast<T*>(Allocate(sizeof(T) * n, alignof(T)));
+        }
+
+        /** @brief Reset frees all memory allocated from this arena.
+         */
+        void Reset();
+
+        size_t BytesAllocated() const { return bytes_allocated_; }
+    };
+}
+
+#endif // ARENA_HPP_
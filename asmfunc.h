@@ -26,7 +26,23 @@ uint64_t CompareExchange(uint64_t* mem, uint64_t expected, uint64_t value);
 
 void LFencedWrite(uint64_t* mem, uint64_t value);
 
-void AsmInthandler21();
+uint64_t ReadMSR(uint32_t msr);
+void WriteMSR(uint32_t msr, uint64_t value);
+uint64_t GetCR3();
+void SetCR3(uint64_t value);
+uint64_t GetCR4();
+void SetCR4(uint64_t value);
+void InvalidateTLB(uint64_t addr);
+void WriteBackInvalidateCache();
+uint64_t ReadTSC();
+
+/** @brief CpuId executes CPUID.
+ *
+ * @param leaf  Value of EAX
+ * @param subleaf  Value of ECX
+ * @param regs  Array receiving EAX, EBX, ECX and EDX in this order.
+ */
+void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t* regs);
 
 #ifdef __cplusplus
 }
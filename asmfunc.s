@@ -53,3 +53,71 @@ LFencedWrite:
         lfence
         mov     [rdi], rsi
         ret
+
+.global ReadMSR
+ReadMSR: # ReadMSR(msr)
+        mov     ecx, edi
+        rdmsr
+        shl     rdx, 32
+        or      rax, rdx
+        ret
+
+.global WriteMSR
+WriteMSR: # WriteMSR(msr, value)
+        mov     ecx, edi
+        mov     eax, esi
+        mov     rdx, rsi
+        shr     rdx, 32
+        wrmsr
+        ret
+
+.global GetCR3
+GetCR3:
+        mov     rax, cr3
+        ret
+
+.global SetCR3
+SetCR3:
+        mov     cr3, rdi
+        ret
+
+.global GetCR4
+GetCR4:
+        mov     rax, cr4
+        ret
+
+.global SetCR4
+SetCR4:
+        mov     cr4, rdi
+        ret
+
+.global InvalidateTLB
+InvalidateTLB: # InvalidateTLB(addr)
+        invlpg  [rdi]
+        ret
+
+.global WriteBackInvalidateCache
+WriteBackInvalidateCache:
+        wbinvd
+        ret
+
+.global CpuId
+CpuId: # CpuId(leaf, subleaf, regs)
+        push    rbx
+        mov     r8, rdx
+        mov     eax, edi
+        mov     ecx, esi
+        cpuid
+        mov     [r8], eax
+        mov     [r8 + 4], ebx
+        mov     [r8 + 8], ecx
+        mov     [r8 + 12], edx
+        pop     rbx
+        ret
+
+.global ReadTSC
+ReadTSC:
+        rdtsc
+        shl     rdx, 32
+        or      rax, rdx
+        ret
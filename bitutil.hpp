@@ -24,6 +24,21 @@ namespace bitutil
         return result;
     }
 
+    inline int BitScanReverse(uint64_t value)
+    {
+        if (value == 0)
+        {
+            return -1;
+        }
+
+        int64_t result;
+        __asm__("bsrq %1, %0  \n\t"
+                : "=r"(result)
+                : "m"(value)
+                );
+        return result;
+    }
+
     /** ClearBits clears the specified bits of value and returns the result.
      *
      * example: ClearBits(0xdeadbeaf, 0xf0f0) == 0xdead0e0f
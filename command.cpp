@@ -3,8 +3,19 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "arena.hpp"
+#include "asmfunc.h"
 #include "bootparam.h"
+#include "debug_console.hpp"
+#include "dma.hpp"
+#include "heap.hpp"
+#include "heapprof.hpp"
+#include "interrupt.hpp"
+#include "memory.hpp"
+#include "paging.hpp"
 #include "pci.hpp"
+#include "slab.hpp"
+#include "timer.hpp"
 #include "xhci.hpp"
 #include "xhci_trb.hpp"
 #include "xhci_er.hpp"
@@ -16,7 +27,7 @@ namespace
 {
     using namespace bitnos;
 
-    void Echo(int argc, char* argv[])
+    void Echo(int argc, char* argv[], memory::Arena& arena)
     {
         if (argc > 1)
         {
@@ -30,24 +41,64 @@ namespace
         fputc('\n', stdout);
     }
 
-    pci::ScanCallbackParam pci_devices[32];
-    size_t num_pci_devices = 0;
+    struct PciDeviceList
+    {
+        const pci::ScanCallbackParam* devices;
+        size_t size;
+    };
 
-    void Lspci(int argc, char* argv[])
+    struct PciDeviceNode
     {
-        if (num_pci_devices == 0)
-        {
-            pci::ScanAllBus([](const pci::ScanCallbackParam& param)
+        pci::ScanCallbackParam param;
+        PciDeviceNode* next;
+    };
+
+    memory::Arena* pci_scan_arena = nullptr;
+    PciDeviceNode* pci_scan_list = nullptr;
+    size_t pci_scan_count = 0;
+
+    /** ScanPciDevices lists all PCI devices in memory taken from arena.
+     */
+    PciDeviceList ScanPciDevices(memory::Arena& arena)
+    {
+        pci_scan_arena = &arena;
+        pci_scan_list = nullptr;
+        pci_scan_count = 0;
+        pci::ScanAllBus([](const pci::ScanCallbackParam& param)
+            {
+                auto node = pci_scan_arena->AllocateArray<PciDeviceNode>(1);
+                if (node)
                 {
-                    pci_devices[num_pci_devices++] = param;
-                });
+                    *node = {param, pci_scan_list};
+                    pci_scan_list = node;
+                    ++pci_scan_count;
+                }
+            });
+
+        auto devices = arena.AllocateArray<pci::ScanCallbackParam>(pci_scan_count);
+        if (devices == nullptr)
+        {
+            return {nullptr, 0};
         }
 
+        // the list is in reverse scan order
+        size_t i = pci_scan_count;
+        for (auto node = pci_scan_list; node; node = node->next)
+        {
+            devices[--i] = node->param;
+        }
+        return {devices, pci_scan_count};
+    }
+
+    void Lspci(int argc, char* argv[], memory::Arena& arena)
+    {
+        const auto pci_devices = ScanPciDevices(arena);
+
         if (argc == 1)
         {
-            for (size_t i = 0; i < num_pci_devices; ++i)
+            for (size_t i = 0; i < pci_devices.size; ++i)
             {
-                const auto& param = pci_devices[i];
+                const auto& param = pci_devices.devices[i];
                 printf("%02x:%02x.%02x"
                     " DEVICE %04x, VENDOR %04x"
                     " CLASS %02x.%02x.%02x HT %02x\n",
@@ -68,11 +119,11 @@ namespace
             }
 
             int device_index = -1;
-            for (int i = 0; i < num_pci_devices; ++i)
+            for (int i = 0; i < pci_devices.size; ++i)
             {
-                if (pci_devices[i].bus == bus
-                        && pci_devices[i].dev == dev
-                        && pci_devices[i].func == func)
+                if (pci_devices.devices[i].bus == bus
+                        && pci_devices.devices[i].dev == dev
+                        && pci_devices.devices[i].func == func)
                 {
                     device_index = i;
                     break;
@@ -85,7 +136,7 @@ namespace
                 return;
             }
 
-            const auto& param = pci_devices[device_index];
+            const auto& param = pci_devices.devices[device_index];
             printf("%02x:%02x.%02x"
                 " DEVICE %04x, VENDOR %04x"
                 " CLASS %02x.%02x.%02x HT %02x\n",
@@ -130,7 +181,7 @@ namespace
         }
     }
 
-    void Mmap(int argc, char* argv[])
+    void Mmap(int argc, char* argv[], memory::Arena& arena)
     {
         const auto base =
             reinterpret_cast<uintptr_t>(kernel_boot_param->memory_map);
@@ -140,25 +191,227 @@ namespace
         for (size_t it = 0; it < mmap_size; it += desc_size)
         {
             auto desc = reinterpret_cast<EFI_MEMORY_DESCRIPTOR*>(base + it);
-            printf("%08llx: %05llx pages\n",
-                desc->PhysicalStart, desc->NumberOfPages);
+            printf("%08llx: %05llx pages, type %u\n",
+                desc->PhysicalStart, desc->NumberOfPages, desc->Type);
+        }
+
+        const auto& frames = *memory::frame_allocator;
+        printf("free frames: %lu / %lu\n",
+            frames.NumFreeFrames(), frames.NumTotalFrames());
+    }
+
+    void Meminfo(int argc, char* argv[], memory::Arena& arena)
+    {
+        printf("  size   in use     free  frames  frag\n");
+        for (size_t i = 0; i < memory::kNumSlabCaches; ++i)
+        {
+            const auto& cache = memory::GetSlabCache(i);
+            const size_t held_bytes = cache.NumFrames() * memory::kBytesPerFrame;
+            const size_t used_bytes = cache.NumInUse() * cache.ObjectSize();
+            const size_t frag_percent = held_bytes == 0 ?
+                0 : 100 * (held_bytes - used_bytes) / held_bytes;
+            printf("%6lu %8lu %8lu %7lu %4lu%%\n",
+                cache.ObjectSize(), cache.NumInUse(), cache.NumFree(),
+                cache.NumFrames(), frag_percent);
         }
+
+        const auto large = memory::GetLargeObjectStat();
+        printf(" large %8lu        - %7lu     -\n",
+            large.num_objects, large.num_frames);
+
+        const auto zeroed = memory::GetZeroedFramePoolStat();
+        const size_t zeroed_requests = zeroed.num_hits + zeroed.num_misses;
+        printf("zeroed frames: %lu pooled, %lu hits / %lu requests\n",
+            zeroed.num_frames, zeroed.num_hits, zeroed_requests);
+
+        const auto heap = memory::GetHeapStat();
+        printf("heap: %lu bytes (%lu mapped) at %016lx\n",
+            heap.size, heap.mapped, heap.base);
+
+        const auto& frames = *memory::frame_allocator;
+        printf("free frames: %lu / %lu\n",
+            frames.NumFreeFrames(), frames.NumTotalFrames());
     }
 
-    void Xhci(int argc, char* argv[])
+    void Heapprof(int argc, char* argv[], memory::Arena& arena)
     {
-        if (num_pci_devices == 0)
+        if (argc == 1)
         {
-            pci::ScanAllBus([](const pci::ScanCallbackParam& param)
+            heapprof::PrintTopCallSites(10);
+        }
+        else if (strcmp(argv[1], "snap") == 0)
+        {
+            heapprof::TakeSnapshot();
+        }
+        else if (strcmp(argv[1], "leaks") == 0)
+        {
+            heapprof::PrintLeaks();
+        }
+        else
+        {
+            printf("usage: heapprof [snap|leaks]\n");
+        }
+    }
+
+    /** Conbench compares drawing text to the console a character at a time
+     * with writing it a line at a time. Both draw the same lines, each
+     * visible on the screen before the next one starts.
+     */
+    void Conbench(int argc, char* argv[], memory::Arena& arena)
+    {
+        if (default_debug_console == nullptr)
+        {
+            return;
+        }
+        auto& cons = *default_debug_console;
+        fflush(stdout);
+
+        const char line[] = "The quick brown fox jumps over the lazy dog 0123456789\n";
+        const size_t len = sizeof(line) - 1;
+        const int kNumLines = 64;
+
+        const auto t0 = ReadTSC();
+        for (int i = 0; i < kNumLines; ++i)
+        {
+            for (size_t j = 0; j < len; ++j)
+            {
+                cons.PutChar(line[j]);
+                cons.Render();
+            }
+        }
+        const auto t1 = ReadTSC();
+        for (int i = 0; i < kNumLines; ++i)
+        {
+            cons.Write(line, len);
+            cons.Render();
+        }
+        const auto t2 = ReadTSC();
+
+        const size_t num_chars = kNumLines * len;
+        const auto tsc_hz = timer::TscFrequency();
+        printf("%lu chars in %d lines\n", num_chars, kNumLines);
+        if (tsc_hz == 0)
+        {
+            printf("PutChar+Render per char: %lu TSC cycles/char\n", (t1 - t0) / num_chars);
+            printf("Write+Render per line:   %lu TSC cycles/char\n", (t2 - t1) / num_chars);
+            return;
+        }
+        printf("PutChar+Render per char: %lu chars/s\n", num_chars * tsc_hz / (t1 - t0));
+        printf("Write+Render per line:   %lu chars/s\n", num_chars * tsc_hz / (t2 - t1));
+    }
+
+    void Intstat(int argc, char* argv[], memory::Arena& arena)
+    {
+        if (argc > 1 && strcmp(argv[1], "reset") == 0)
+        {
+            interrupt::ResetStats();
+            return;
+        }
+
+        printf("vec     count       min       avg       max (cycles)\n");
+        for (size_t v = 0; v < interrupt::kNumVectors; ++v)
+        {
+            const auto& s = interrupt::Stats(v);
+            if (s.count == 0)
+            {
+                continue;
+            }
+            if (s.total_cycles == 0)
+            {
+                // counted without a handler
+                printf(" %02lx %9lu         -         -         -\n", v, s.count);
+                continue;
+            }
+            printf(" %02lx %9lu %9lu %9lu %9lu\n",
+                v, s.count, s.min_cycles, s.total_cycles / s.count, s.max_cycles);
+        }
+    }
+
+    void Clock(int argc, char* argv[], memory::Arena& arena)
+    {
+        const char* sources[] = {"none", "HPET", "PIT"};
+        const char* devices[] = {"none", "TSC-deadline", "LAPIC one-shot"};
+        printf("TSC %lu Hz (calibrated by %s, %s), timer %s\n",
+            timer::TscFrequency(), sources[static_cast<int>(timer::Source())],
+            timer::InvariantTsc() ? "invariant" : "not invariant",
+            devices[static_cast<int>(timer::Device())]);
+        printf("now %lu ns\n", timer::NowNs());
+        if (timer::Device() == timer::TimerDevice::kNone)
+        {
+            return;
+        }
+
+        // how late one-shot timers fire
+        volatile uint64_t fired_ns;
+        timer::Timer t{};
+        t.data = const_cast<uint64_t*>(&fired_ns);
+        t.callback = [](timer::Timer& timer)
+            {
+                *static_cast<volatile uint64_t*>(timer.data) = timer::NowNs();
+            };
+        const uint64_t delays_us[] = {100, 1000, 10000};
+        for (auto delay_us : delays_us)
+        {
+            fired_ns = 0;
+            const auto deadline = timer::NowNs() + 1000 * delay_us;
+            timer::Start(t, deadline);
+            for (;;)
+            {
+                __asm__("cli");
+                if (fired_ns != 0)
                 {
-                    pci_devices[num_pci_devices++] = param;
-                });
+                    __asm__("sti");
+                    break;
+                }
+                __asm__("sti\n\thlt"); // no interrupt can slip in between
+            }
+            printf("%6lu us timer: %lu ns late\n", delay_us, fired_ns - deadline);
+        }
+    }
+
+    const size_t kCommandRingSize = 8;
+    const uint64_t kXhciTimeoutNs = 1000000000;
+    xhci::TRB* cr_buf = nullptr;
+    dma::Pool* xhci_ring_pool = nullptr;
+    dma::Pool* xhci_context_pool = nullptr;
+
+    void Xhci(int argc, char* argv[], memory::Arena& arena)
+    {
+        if (xhci_ring_pool == nullptr || xhci_context_pool == nullptr)
+        {
+            // rings must not cross 64 KiB, contexts must not cross a page
+            delete xhci_ring_pool;
+            delete xhci_context_pool;
+            xhci_ring_pool = new dma::Pool(
+                sizeof(xhci::TRB) * kCommandRingSize, 64);
+            xhci_context_pool = new dma::Pool(
+                sizeof(xhci::InputContext), 64, memory::kBytesPerFrame);
+            if (xhci_ring_pool == nullptr || xhci_context_pool == nullptr)
+            {
+                printf("no memory for the DMA pools\n");
+                return;
+            }
+        }
+        if (cr_buf != nullptr)
+        {
+            // left by an earlier run; the pool clears it on reuse
+            xhci_ring_pool->Free({cr_buf, dma::ToBusAddress(cr_buf)});
+            cr_buf = nullptr;
+        }
+        auto ring = xhci_ring_pool->Allocate();
+        if (IsError(ring.error))
+        {
+            printf("failed to allocate a command ring: %d\n", ring.error);
+            return;
         }
+        cr_buf = reinterpret_cast<xhci::TRB*>(ring.value.cpu_addr);
+
+        const auto pci_devices = ScanPciDevices(arena);
 
         size_t xhci_dev_index = 0;
-        for (xhci_dev_index = 0; xhci_dev_index < num_pci_devices; ++xhci_dev_index)
+        for (xhci_dev_index = 0; xhci_dev_index < pci_devices.size; ++xhci_dev_index)
         {
-            const auto& p = pci_devices[xhci_dev_index];
+            const auto& p = pci_devices.devices[xhci_dev_index];
             if (p.base_class == 0x0c && p.sub_class == 0x03 && p.interface == 0x30)
             {
                 printf("found an xHCI device at %02x:%02x.%02x\n",
@@ -167,16 +420,28 @@ namespace
             }
         }
 
-        if (xhci_dev_index == num_pci_devices)
+        if (xhci_dev_index == pci_devices.size)
         {
             printf("no xHCI device\n");
             return;
         }
 
-        const auto& dev_param = pci_devices[xhci_dev_index];
+        const auto& dev_param = pci_devices.devices[xhci_dev_index];
         pci::NormalDevice xhci_dev(dev_param.bus, dev_param.dev, dev_param.func);
         const auto bar = pci::ReadBar(xhci_dev, 0);
         const auto mmio_base = bitutil::ClearBits(bar.value, 0xf);
+        const auto map_size = pci::CalcBarMapSize(xhci_dev, 0);
+        if (IsError(map_size.error))
+        {
+            printf("failed to get the MMIO size: %d\n", map_size.error);
+            return;
+        }
+        auto err = paging::MapMmio(mmio_base, map_size.value);
+        if (IsError(err))
+        {
+            printf("failed to map the MMIO: %d\n", err);
+            return;
+        }
 
         xhci::Controller xhc(mmio_base);
         auto& cap_reg = xhc.CapabilityRegisters();
@@ -196,12 +461,10 @@ namespace
         const auto max_ports = xhci::MaxPorts(xhc);
         const auto max_slots_enabled = xhci::MaxSlotsEnabled(xhc);
 
-        alignas(64) xhci::TRB cr_buf[8];
         size_t cr_enqueue_ptr = 0;
         unsigned char cr_cycle_bit = 1;
-        memset(cr_buf, 0, sizeof(cr_buf));
-        op_reg.CRCR.Write(reinterpret_cast<uint64_t>(&cr_buf[0]) | cr_cycle_bit);
-        printf("Write to CRCR cr_buf=%016lx\n", reinterpret_cast<uint64_t>(&cr_buf[0]));
+        op_reg.CRCR.Write(dma::ToBusAddress(cr_buf) | cr_cycle_bit);
+        printf("Write to CRCR cr_buf=%016lx\n", dma::ToBusAddress(cr_buf));
 
 
         auto interrupter_reg_sets = xhc.InterrupterRegSets();
@@ -277,8 +540,15 @@ namespace
                     ep.bits.max_burst_size, ep.bits.max_packet_size);
             }
 
-            xhci::InputContext input_context;
-            memset(&input_context, 0, sizeof(input_context));
+            auto input_context_buf = xhci_context_pool->Allocate();
+            if (IsError(input_context_buf.error))
+            {
+                printf("failed to allocate an input context: %d\n",
+                    input_context_buf.error);
+                break;
+            }
+            auto& input_context = *reinterpret_cast<xhci::InputContext*>(
+                input_context_buf.value.cpu_addr); // zero-filled
             const unsigned int ep_enabling = 1;
             input_context.input_control_context.add_context_flags
                 |= (1 << (2 * ep_enabling));
@@ -287,7 +557,7 @@ namespace
             xhci::ConfigureEndpointCommandTRB cmd{};
             cmd.bits.cycle_bit = cr_cycle_bit;
             cmd.bits.input_context_pointer = (
-                reinterpret_cast<uint64_t>(&input_context) >> 4);
+                input_context_buf.value.bus_addr >> 4);
             cmd.bits.trb_type = 12;
             cmd.bits.slot_id = slot_id;
 
@@ -306,7 +576,13 @@ namespace
             printf("doorbell written. R/S=%u, CRR=%u\n",
                 op_reg.USBCMD.Read() & 1u, (op_reg.CRCR.Read() >> 3) & 1u);
 
-            while ((op_reg.CRCR.Read() & 8) == 0);
+            if (!timer::PollUntil([&]{ return (op_reg.CRCR.Read() & 8) != 0; },
+                                  kXhciTimeoutNs))
+            {
+                // the controller may still read the input context, so keep it
+                printf("timeout: CRCR.CRR stays 0\n");
+                break;
+            }
 
             printf("CRCR %016lx\n", op_reg.CRCR.Read());
 
@@ -316,7 +592,11 @@ namespace
             printf("waiting completion event (c=%d)\n",
                 er_mgr.Front().bits.cycle_bit);
 
-            while (!er_mgr.HasFront());
+            if (!timer::PollUntil([&]{ return er_mgr.HasFront(); }, kXhciTimeoutNs))
+            {
+                printf("timeout: no completion event\n");
+                break;
+            }
 
             auto trb = er_mgr.Front();
             er_mgr.Pop();
@@ -324,6 +604,8 @@ namespace
             printf("completed! TRB type=%u ptr=%016lx\n",
                 trb.bits.trb_type, &trb);
 
+            xhci_context_pool->Free(input_context_buf.value);
+
         }
 
         /*
@@ -413,10 +695,15 @@ namespace
 
 namespace bitnos::command
 {
-    Command table[4] = {
+    Command table[9] = {
         {"echo", Echo},
         {"lspci", Lspci},
         {"mmap", Mmap},
         {"xhci", Xhci},
+        {"meminfo", Meminfo},
+        {"heapprof", Heapprof},
+        {"conbench", Conbench},
+        {"intstat", Intstat},
+        {"clock", Clock},
     };
 }
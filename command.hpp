@@ -1,11 +1,16 @@
 #ifndef COMMAND_HPP_
 #define COMMAND_HPP_
 
+#include "arena.hpp"
 #include "errorcode.hpp"
 
 namespace bitnos::command
 {
-    using FuncType = void (int argc, char* argv[]);
+    /*
+     * argv and everything a command allocates from arena stay valid until
+     * the shell resets the arena at the start of the next command.
+     */
+    using FuncType = void (int argc, char* argv[], memory::Arena& arena);
 
     struct Command
     {
@@ -13,7 +18,7 @@ namespace bitnos::command
         FuncType* func_ptr;
     };
 
-    extern Command table[4];
+    extern Command table[9];
 }
 
 #endif // COMMAND_HPP_
@@ -1,10 +1,7 @@
 #include "debug_console.hpp"
 
-#include <stdio.h>
 #include <string.h>
 
-#include "command.hpp"
-
 namespace bitnos
 {
     using graphics::Point;
@@ -18,11 +15,58 @@ namespace bitnos
         {
             return {8 * cur.x, 16 * cur.y};
         }
+
+        /** ToHankaku maps a half-width code point to the hankaku font. */
+        char32_t ToHankaku(char32_t code)
+        {
+            if (code < 0x80)
+            {
+                return code;
+            }
+            if (0xff61 <= code && code <= 0xff9f)
+            {
+                // halfwidth katakana are at 0xa1 in JIS X 0201
+                return code - 0xff61 + 0xa1;
+            }
+            return '?';
+        }
     }
 
     DebugConsole::DebugConsole(PixelWriter& writer, const RectSize& size)
-        : writer_(writer), size_(size), cur_({0, 0})
-    {}
+        : writer_(writer), size_(size), cur_({0, 0}),
+          glyphs_(writer, {0, 0, 0, 0}, {255, 255, 255, 0}),
+          wide_glyphs_(writer, {0, 0, 0, 0}, {255, 255, 255, 0}),
+          cells_(new Cell[size.width * size.height]),
+          rendered_(new Cell[size.width * size.height]),
+          top_(0), display_(nullptr), origin_(0), scrolled_(0)
+    {
+        if (cells_ == nullptr || rendered_ == nullptr)
+        {
+            delete[] cells_;
+            delete[] rendered_;
+            cells_ = rendered_ = nullptr;
+            return;
+        }
+
+        for (unsigned int i = 0; i < size_.width * size_.height; ++i)
+        {
+            cells_[i] = {' ', 0};
+        }
+        Invalidate();
+    }
+
+    DebugConsole::Cell* DebugConsole::Row(unsigned int y)
+    {
+        return cells_ + size_.width * ((top_ + y) % size_.height);
+    }
+
+    void DebugConsole::Invalidate()
+    {
+        for (unsigned int i = 0; i < size_.width * size_.height; ++i)
+        {
+            rendered_[i] = {0, kAttrInvalid};
+        }
+    }
 
     void DebugConsole::Newline()
     {
@@ -30,10 +74,16 @@ namespace bitnos
         if (cur_.y < size_.height - 1)
         {
             ++cur_.y;
+            return;
         }
-        else
+
+        // the old top row becomes the new bottom row
+        top_ = (top_ + 1) % size_.height;
+        ++scrolled_;
+        auto row = Row(size_.height - 1);
+        for (unsigned int x = 0; x < size_.width; ++x)
         {
-            // scroll
+            row[x] = {' ', 0};
         }
     }
 
@@ -42,149 +92,242 @@ namespace bitnos
         if (cur_.x > 0)
         {
             --cur_.x;
-            return;
         }
-
-        cur_.x = static_cast<decltype(cur_.x)>(size_.width - 1);
-        if (cur_.y > 0)
+        else if (cur_.y > 0)
         {
+            cur_.x = static_cast<decltype(cur_.x)>(size_.width - 1);
             --cur_.y;
         }
-        else
+
+        auto row = Row(cur_.y);
+        if (row[cur_.x].attr & kAttrWideRight && cur_.x > 0)
         {
-            // scroll
+            --cur_.x;
         }
+        ClearWide(row, cur_.x);
+        row[cur_.x] = {' ', 0};
     }
 
-    void DebugConsole::DrawCursor()
-    {
-        DrawRect(writer_, ToPixel(cur_), {8, 16}, {255, 255, 255, 0});
-        DrawAscii(writer_, ToPixel(cur_), '_');
-    }
-
-    void DebugConsole::EraseCursor()
+    void DebugConsole::ClearWide(Cell* row, int x)
     {
-        DrawRect(writer_, ToPixel(cur_), {8, 16}, {255, 255, 255, 0});
+        // the other half of a full-width character being overwritten
+        if (row[x].attr & kAttrWide && x + 1 < static_cast<int>(size_.width))
+        {
+            row[x + 1] = {' ', 0};
+        }
+        else if (row[x].attr & kAttrWideRight && x > 0)
+        {
+            row[x - 1] = {' ', 0};
+        }
     }
 
-    void DebugConsole::PutChar(char ch)
+    void DebugConsole::Put(char32_t code, Cell*& row)
     {
-        EraseCursor();
-
-        switch (ch)
+        switch (code)
         {
         case '\n':
             Newline();
+            row = Row(cur_.y);
             return;
         case '\b':
             Backspace();
-            DrawCursor();
+            row = Row(cur_.y);
             return;
         }
 
-        DrawAscii(writer_, ToPixel(cur_), ch);
-        if (cur_.x < size_.width - 1)
+        const int width = size_.width;
+        if (!graphics::IsFullWidth(code) || width < 2)
         {
+            ClearWide(row, cur_.x);
+            row[cur_.x] = {ToHankaku(code), 0};
             ++cur_.x;
         }
         else
+        {
+            if (cur_.x == width - 1)
+            {
+                ClearWide(row, cur_.x);
+                row[cur_.x] = {' ', 0};
+                Newline();
+                row = Row(cur_.y);
+            }
+            ClearWide(row, cur_.x);
+            ClearWide(row, cur_.x + 1);
+            row[cur_.x] = {code, kAttrWide};
+            row[cur_.x + 1] = {0, kAttrWideRight};
+            cur_.x += 2;
+        }
+
+        if (cur_.x == width)
         {
             Newline();
+            row = Row(cur_.y);
         }
+    }
 
-        DrawCursor();
+    void DebugConsole::PutChar(char ch)
+    {
+        Write(&ch, 1);
     }
 
     void DebugConsole::PutStr(const char *s)
     {
-        while (*s)
-        {
-            PutChar(*s++);
-        }
+        Write(s, strlen(s));
     }
 
-    void DebugShell::Exec()
+    void DebugConsole::Write(const char* s, size_t len)
     {
-        const auto len = strlen(buf_);
-        if (len == 0)
+        if (cells_ == nullptr)
         {
             return;
         }
 
-        char s[len + 1];
-
-        int argc = 0;
-        char *argv[128];
-
-        int i = 0;
-        while (true)
+        auto row = Row(cur_.y);
+        char32_t codes[2];
+        for (size_t i = 0; i < len; ++i)
         {
-            for (; i < len && buf_[i] == ' '; ++i)
-            {
-                s[i] = '\0';
-            }
-            if (i > len)
+            const auto n = decoder_.Feed(s[i], codes);
+            for (int j = 0; j < n; ++j)
             {
-                break;
+                Put(codes[j], row);
             }
-            argv[argc++] = s + i;
-            for (; i < len && buf_[i] != ' '; ++i)
-            {
-                s[i] = buf_[i];
-            }
-            s[i++] = '\0';
         }
+    }
 
-        bool found = false;
-        for (const auto& cmd : command::table)
+    void DebugConsole::SetColors(const Color& fg, const Color& bg)
+    {
+        glyphs_.SetColors(fg, bg);
+        wide_glyphs_.SetColors(fg, bg);
+        if (cells_)
         {
-            if (strcmp(argv[0], cmd.name) == 0)
-            {
-                found = true;
-                cmd.func_ptr(argc, argv);
-                break;
-            }
+            Invalidate();
         }
+    }
 
-        if (!found)
+    void DebugConsole::UseDisplay(graphics::ScrollableDisplay& display)
+    {
+        display_ = &display;
+        origin_ = 0;
+        scrolled_ = 0;
+        display_->SetYOffset(origin_);
+        if (cells_)
         {
-            printf("no such command: %s\n", argv[0]);
+            Invalidate();
         }
     }
 
-    DebugShell::DebugShell(DebugConsole& cons)
-        : cons_(cons), cur_(0), prompt_str_(kDefaultPrompt)
+    void DebugConsole::ScrollDisplay()
     {
-        cons_.PutStr(prompt_str_);
+        const unsigned int screen_height = 16 * size_.height;
+        const unsigned int shift = 16 * scrolled_;
+        if (scrolled_ < size_.height &&
+            origin_ + shift + screen_height <= display_->VirtualHeight())
+        {
+            // rows still visible are already drawn where the window moves
+            const auto num_kept = size_.height - scrolled_;
+            memmove(rendered_, rendered_ + size_.width * scrolled_,
+                    sizeof(Cell) * size_.width * num_kept);
+            for (auto i = size_.width * num_kept; i < size_.width * size_.height; ++i)
+            {
+                rendered_[i] = {0, kAttrInvalid};
+            }
+            origin_ += shift;
+            return;
+        }
+
+        // redraw the whole screen out of sight, then flip to it
+        if (origin_ >= screen_height)
+        {
+            origin_ = 0;
+        }
+        else if (origin_ + 2 * screen_height <= display_->VirtualHeight())
+        {
+            origin_ += screen_height;
+        }
+        else
+        {
+            origin_ = 0;
+        }
+        Invalidate();
     }
 
-    void DebugShell::PutChar(char ch)
+    void DebugConsole::Render()
     {
-        if (cur_ > kLineLength-1)
+        if (cells_ == nullptr)
         {
             return;
         }
 
-        switch (ch)
+        const auto old_origin = origin_;
+        if (display_ && scrolled_ > 0)
         {
-        case '\n':
-            buf_[cur_] = '\0';
-            cur_ = 0;
-            cons_.PutChar('\n');
-            Exec();
-            cons_.PutStr(prompt_str_);
-            return;
-        case '\b':
-            if (cur_ == 0)
+            ScrollDisplay();
+        }
+        scrolled_ = 0;
+        const Point origin = {0, static_cast<int>(origin_)};
+
+        char run[GlyphCache::kMaxStringLength];
+        for (unsigned int y = 0; y < size_.height; ++y)
+        {
+            const auto row = Row(y);
+            auto shown = rendered_ + size_.width * y;
+            auto CellAt = [&](unsigned int x)
+            {
+                auto cell = row[x];
+                if (x == static_cast<unsigned int>(cur_.x) && y == static_cast<unsigned int>(cur_.y))
+                {
+                    cell.attr |= kAttrCursor;
+                }
+                return cell;
+            };
+            auto Changed = [&](unsigned int x)
             {
-                return;
+                const auto cell = CellAt(x);
+                return cell.code != shown[x].code || cell.attr != shown[x].attr;
+            };
+
+            // draw each run of changed half-width cells at once
+            unsigned int x = 0;
+            while (x < size_.width)
+            {
+                const Point pos = {static_cast<int>(x), static_cast<int>(y)};
+                const auto cell = CellAt(x);
+                if (cell.attr & kAttrWide && x + 1 < size_.width)
+                {
+                    if (Changed(x) || Changed(x + 1))
+                    {
+                        wide_glyphs_.Draw(origin + ToPixel(pos), cell.code);
+                        shown[x] = cell;
+                        shown[x + 1] = CellAt(x + 1);
+                    }
+                    x += 2;
+                    continue;
+                }
+                if (!Changed(x))
+                {
+                    ++x;
+                    continue;
+                }
+
+                size_t n = 0;
+                for (; x < size_.width && n < GlyphCache::kMaxStringLength && Changed(x); ++x)
+                {
+                    const auto c = CellAt(x);
+                    if (c.attr & kAttrWide && x + 1 < size_.width)
+                    {
+                        break;
+                    }
+                    run[n++] = c.attr & kAttrCursor ? '_'
+                        : c.attr & kAttrWideRight ? ' ' : static_cast<char>(c.code);
+                    shown[x] = c;
+                }
+                glyphs_.DrawString(origin + ToPixel(pos), run, n);
             }
-            --cur_;
-            break;
-        default:
-            buf_[cur_++] = ch;
         }
 
-        cons_.PutChar(ch);
+        if (display_ && origin_ != old_origin)
+        {
+            display_->SetYOffset(origin_);
+        }
     }
 }
@@ -2,53 +2,88 @@
 #define DEBUG_CONSOLE_HPP_
 
 #include "graphics.hpp"
+#include "utf8.hpp"
 
 namespace bitnos
 {
+    using graphics::Color;
+    using graphics::GlyphCache;
     using graphics::PixelWriter;
     using graphics::Point;
     using graphics::RectSize;
 
+    /** @brief DebugConsole is a text console on a pixel writer.
+     *
+     * Text is kept in a ring of rows of cells, so scrolling moves the top
+     * row index instead of the text. PutChar only updates cells; Render()
+     * draws the cells whose contents differ from what is on the screen.
+     *
+     * Output is UTF-8. A full-width character takes two cells, the right
+     * one only marking that it is occupied.
+     *
+     * With a ScrollableDisplay, the screen is a window of a taller frame
+     * buffer and scrolling moves the window, so rows that stay visible are
+     * not redrawn. When the window reaches the end of the frame buffer,
+     * the screen is redrawn at another place and shown at once.
+     */
     class DebugConsole
     {
+        struct Cell
+        {
+            char32_t code; // hankaku index, or a code point if kAttrWide
+            uint8_t attr;
+        };
+
+        static const uint8_t kAttrCursor = 0x01u;
+        static const uint8_t kAttrWide = 0x02u; // left half of a full-width character
+        static const uint8_t kAttrWideRight = 0x04u; // right half, drawn with the left
+        static const uint8_t kAttrInvalid = 0xffu; // never matches a cell
+
         PixelWriter& writer_;
         RectSize size_;
         Point cur_;
+        GlyphCache glyphs_;
+        graphics::WideGlyphCache wide_glyphs_;
+        utf8::Decoder decoder_;
+        Cell* cells_;
+        Cell* rendered_; // drawn cells in screen row order
+        unsigned int top_; // index in cells_ of the top screen row
+        graphics::ScrollableDisplay* display_;
+        unsigned int origin_; // frame buffer line shown at the top
+        unsigned int scrolled_; // rows scrolled since the last Render()
 
+        Cell* Row(unsigned int y);
+        void Invalidate();
+        void ScrollDisplay();
         void Newline();
         void Backspace();
-        void DrawCursor();
-        void EraseCursor();
+        void ClearWide(Cell* row, int x);
+        void Put(char32_t code, Cell*& row);
 
     public:
         DebugConsole(PixelWriter& writer, const RectSize& size);
 
         void PutChar(char ch);
         void PutStr(const char *s);
-    };
 
-    extern DebugConsole* default_debug_console;
-
-    const char* const kDefaultPrompt = "$ ";
-
-    //typedef void (DebugShellExecutorType)(DebugConsole& cons, const char* cmdline);
-    class DebugShell
-    {
-        static const int kLineLength = 512;
+        /** @brief Write lays out len characters from s.
+         * '\n' and '\b' are handled as PutChar does.
+         */
+        void Write(const char* s, size_t len);
 
-        DebugConsole& cons_;
-        int cur_;
-        char buf_[kLineLength];
+        /** @brief SetColors changes the colors of all characters. */
+        void SetColors(const Color& fg, const Color& bg);
 
-        const char* prompt_str_;
+        /** @brief Render draws the cells changed since the last call. */
+        void Render();
 
-        void Exec();
-
-    public:
-        DebugShell(DebugConsole& cons);
-
-        void PutChar(char ch);
+        /** @brief UseDisplay scrolls by moving the window of display.
+         * The writer must cover the whole frame buffer of display.
+         */
+        void UseDisplay(graphics::ScrollableDisplay& display);
     };
+
+    extern DebugConsole* default_debug_console;
 }
 
 #endif // DEBUG_CONSOLE_HPP_
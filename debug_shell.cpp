@@ -0,0 +1,114 @@
+#include "debug_shell.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "command.hpp"
+
+namespace bitnos
+{
+    void DebugShell::Exec()
+    {
+        const auto len = strlen(buf_);
+        if (len == 0)
+        {
+            return;
+        }
+
+        arena_.Reset();
+        auto s = arena_.AllocateArray<char>(len + 1);
+        if (s == nullptr)
+        {
+            printf("no memory to run a command\n");
+            return;
+        }
+        memcpy(s, buf_, len + 1);
+
+        int argc = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (s[i] != ' ' && (i == 0 || s[i - 1] == ' '))
+            {
+                ++argc;
+            }
+        }
+        if (argc == 0)
+        {
+            return;
+        }
+
+        auto argv = arena_.AllocateArray<char*>(argc + 1);
+        if (argv == nullptr)
+        {
+            printf("no memory to run a command\n");
+            return;
+        }
+
+        argc = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            if (s[i] == ' ')
+            {
+                s[i] = '\0';
+            }
+            else if (i == 0 || s[i - 1] == '\0')
+            {
+                argv[argc++] = s + i;
+            }
+        }
+        argv[argc] = nullptr;
+
+        bool found = false;
+        for (const auto& cmd : command::table)
+        {
+            if (strcmp(argv[0], cmd.name) == 0)
+            {
+                found = true;
+                cmd.func_ptr(argc, argv, arena_);
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            printf("no such command: %s\n", argv[0]);
+        }
+        fflush(stdout);
+    }
+
+    DebugShell::DebugShell(DebugConsole& cons)
+        : cons_(cons), cur_(0), prompt_str_(kDefaultPrompt)
+    {
+        cons_.PutStr(prompt_str_);
+    }
+
+    void DebugShell::PutChar(char ch)
+    {
+        if (cur_ > kLineLength-1)
+        {
+            return;
+        }
+
+        switch (ch)
+        {
+        case '\n':
+            buf_[cur_] = '\0';
+            cur_ = 0;
+            cons_.PutChar('\n');
+            Exec();
+            cons_.PutStr(prompt_str_);
+            return;
+        case '\b':
+            if (cur_ == 0)
+            {
+                return;
+            }
+            --cur_;
+            break;
+        default:
+            buf_[cur_++] = ch;
+        }
+
+        cons_.PutChar(ch);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef DEBUG_SHELL_HPP_
+#define DEBUG_SHELL_HPP_
+
+#include "arena.hpp"
+#include "debug_console.hpp"
+
+namespace bitnos
+{
+    const char* const kDefaultPrompt = "$ ";
+
+    //typedef void (DebugShellExecutorType)(DebugConsole& cons, const char* cmdline);
+    class DebugShell
+    {
+        static const int kLineLength = 512;
+
+        DebugConsole& cons_;
+        int cur_;
+        char buf_[kLineLength];
+
+        const char* prompt_str_;
+        memory::Arena arena_;
+
+        void Exec();
+
+    public:
+        DebugShell(DebugConsole& cons);
+
+        void PutChar(char ch);
+    };
+}
+
+#endif // DEBUG_SHELL_HPP_
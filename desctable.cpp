@@ -1,5 +1,7 @@
 #include "desctable.hpp"
 
+#include <string.h>
+
 #include "bitutil.hpp"
 
 namespace bitnos
@@ -34,6 +36,21 @@ namespace bitnos
         return MakeDTR(idtr);
     }
 
+    void LoadIDTR(DescriptorTableRegister idtr)
+    {
+        uint8_t buf[kDTRBufSize];
+        memcpy(&buf[0], &idtr.limit, sizeof(idtr.limit));
+        memcpy(&buf[2], &idtr.base, sizeof(idtr.base));
+        __asm__("lidt %0" : : "m"(buf));
+    }
+
+    uint16_t GetCS()
+    {
+        uint16_t cs;
+        __asm__("mov %%cs, %0" : "=r"(cs));
+        return cs;
+    }
+
     Error SetIDTEntry(
         DescriptorTableRegister idtr, size_t index,
         uint64_t offset, uint16_t attr, uint16_t selector)
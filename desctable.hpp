@@ -16,6 +16,8 @@ namespace bitnos
 
     DescriptorTableRegister GetGDTR();
     DescriptorTableRegister GetIDTR();
+    void LoadIDTR(DescriptorTableRegister idtr);
+    uint16_t GetCS();
 
     constexpr uint16_t MakeIDTAttr(
         uint8_t p, uint8_t dpl, uint8_t type, uint8_t ist)
@@ -0,0 +1,123 @@
+#include "dma.hpp"
+
+#include <string.h>
+
+#include "bitutil.hpp"
+#include "memory.hpp"
+
+namespace
+{
+    using namespace bitnos;
+
+    size_t RoundUp(size_t value, size_t align)
+    {
+        return bitutil::ClearBits(value + align - 1, align - 1);
+    }
+
+    unsigned int ChunkOrder(size_t block_size)
+    {
+        const size_t num_frames =
+            RoundUp(block_size, memory::kBytesPerFrame) / memory::kBytesPerFrame;
+        unsigned int order = bitutil::BitScanReverse(num_frames);
+        if ((static_cast<size_t>(1) << order) < num_frames)
+        {
+            ++order;
+        }
+        return order;
+    }
+}
+
+namespace bitnos::dma
+{
+    Pool::Pool(size_t block_size, size_t align, size_t boundary)
+        : block_size_(block_size),
+          stride_(RoundUp(block_size, align < sizeof(FreeBlock) ? sizeof(FreeBlock) : align)),
+          boundary_(boundary),
+          chunk_order_(ChunkOrder(block_size)),
+          free_list_(nullptr), carve_(0), carve_end_(0),
+          num_blocks_(0), num_free_(0)
+    {}
+
+    Error Pool::Grow()
+    {
+        if (block_size_ == 0 || block_size_ > boundary_)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        const size_t chunk_bytes = memory::kBytesPerFrame << chunk_order_;
+        WithError<uintptr_t> chunk;
+        if (chunk_order_ == memory::kOrder4KiB)
+        {
+            chunk = memory::AllocateZeroedFrame();
+        }
+        else
+        {
+            chunk = memory::frame_allocator->Allocate(chunk_order_);
+            if (!IsError(chunk.error))
+            {
+                memset(reinterpret_cast<void*>(chunk.value), 0, chunk_bytes);
+            }
+        }
+        if (IsError(chunk.error))
+        {
+            return chunk.error;
+        }
+
+        carve_ = chunk.value;
+        carve_end_ = chunk.value + chunk_bytes;
+        return errorcode::kSuccess;
+    }
+
+    void* Pool::Carve()
+    {
+        while (carve_ + block_size_ <= carve_end_)
+        {
+            const auto next_boundary =
+                bitutil::ClearBits(carve_, boundary_ - 1) + boundary_;
+            if (carve_ + block_size_ > next_boundary)
+            {
+                carve_ = next_boundary;
+                continue;
+            }
+
+            auto block = reinterpret_cast<void*>(carve_);
+            carve_ += stride_;
+            ++num_blocks_;
+            return block;
+        }
+        return nullptr;
+    }
+
+    WithError<Buffer> Pool::Allocate()
+    {
+        if (free_list_ != nullptr)
+        {
+            auto block = free_list_;
+            free_list_ = block->next;
+            --num_free_;
+            memset(block, 0, block_size_);
+            return {{block, ToBusAddress(block)}, errorcode::kSuccess};
+        }
+
+        auto block = Carve();
+        if (block == nullptr)
+        {
+            auto err = Grow();
+            if (IsError(err))
+            {
+                return {{nullptr, 0}, err};
+            }
+            block = Carve(); // a chunk holds at least one block
+        }
+        return {{block, ToBusAddress(block)}, errorcode::kSuccess};
+    }
+
+    void Pool::Free(const Buffer& buf)
+    {
+        auto block = reinterpret_cast<FreeBlock*>(buf.cpu_addr);
+        block->next = free_list_;
+        free_list_ = block;
+        ++num_free_;
+    }
+}
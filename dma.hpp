@@ -0,0 +1,80 @@
+#ifndef DMA_HPP_
+#define DMA_HPP_
+
+/** @file dma.hpp provides pools of buffers which devices access directly,
+ * such as xHCI rings and contexts.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "errorcode.hpp"
+
+namespace bitnos::dma
+{
+    const size_t kDefaultBoundary = 64 * 1024;
+
+    struct Buffer
+    {
+        void* cpu_addr;
+        uintptr_t bus_addr;
+    };
+
+    /** @brief Pool hands out fixed-size, zero-filled blocks for DMA.
+     *
+     * Every block is aligned to the given alignment and never crosses
+     * the given boundary. Blocks are carved on demand from zeroed chunks
+     * (single frames come from the pre-zeroed frame pool) and recycled
+     * through a free list embedded in the free blocks. Only recycled
+     * blocks are cleared by Allocate.
+     */
+    class Pool
+    {
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        const size_t block_size_;
+        const size_t stride_;
+        const size_t boundary_;
+        const unsigned int chunk_order_;
+        FreeBlock* free_list_;
+        uintptr_t carve_;     // the untouched rest of the last chunk
+        uintptr_t carve_end_;
+        size_t num_blocks_;
+        size_t num_free_;
+
+        Error Grow();
+        void* Carve();
+
+    public:
+        /**
+         * @param block_size  Size of a block in bytes
+         * @param align  Alignment of blocks (power of two)
+         * @param boundary  Blocks never cross a multiple of this value
+         *   (power of two, not less than block_size)
+         */
+        Pool(size_t block_size, size_t align, size_t boundary = kDefaultBoundary);
+        Pool(const Pool&) = delete;
+        Pool& operator =(const Pool&) = delete;
+
+        WithError<Buffer> Allocate();
+        void Free(const Buffer& buf);
+
+        size_t BlockSize() const { return block_size_; }
+        size_t NumBlocks() const { return num_blocks_; }
+        size_t NumFree() const { return num_free_; }
+    };
+
+    /** @brief ToBusAddress returns the address a device uses
+     * to access cpu_addr.
+     */
+    inline uintptr_t ToBusAddress(const void* cpu_addr)
+    {
+        // the kernel identity maps physical memory and there is no IOMMU
+        return reinterpret_cast<uintptr_t>(cpu_addr);
+    }
+}
+
+#endif // DMA_HPP_
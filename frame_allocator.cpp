@@ -0,0 +1,219 @@
+#include "memory.hpp"
+
+#include "bitutil.hpp"
+
+namespace bitnos::memory
+{
+    FrameAllocator::FrameAllocator()
+        : free_head_map_{}, free_lists_{}, num_free_blocks_{},
+          num_free_frames_(0), num_total_frames_(0), reclaim_(nullptr)
+    {}
+
+    bool FrameAllocator::IsFreeHead(size_t frame) const
+    {
+        const auto bit = static_cast<MapLineType>(1) << (frame % kBitsPerMapLine);
+        return (free_head_map_[frame / kBitsPerMapLine] & bit) != 0;
+    }
+
+    void FrameAllocator::SetFreeHead(size_t frame, bool head)
+    {
+        const auto bit = static_cast<MapLineType>(1) << (frame % kBitsPerMapLine);
+        if (head)
+        {
+            free_head_map_[frame / kBitsPerMapLine] |= bit;
+        }
+        else
+        {
+            free_head_map_[frame / kBitsPerMapLine] &= ~bit;
+        }
+    }
+
+    FrameAllocator::FreeBlock* FrameAllocator::BlockAt(size_t frame) const
+    {
+        return reinterpret_cast<FreeBlock*>(frame * kBytesPerFrame);
+    }
+
+    void FrameAllocator::Link(size_t frame, unsigned int order)
+    {
+        auto block = BlockAt(frame);
+        block->order = order;
+        block->prev = nullptr;
+        block->next = free_lists_[order];
+        if (block->next)
+        {
+            block->next->prev = block;
+        }
+        free_lists_[order] = block;
+        ++num_free_blocks_[order];
+        SetFreeHead(frame, true);
+    }
+
+    void FrameAllocator::Unlink(size_t frame, unsigned int order)
+    {
+        auto block = BlockAt(frame);
+        if (block->prev)
+        {
+            block->prev->next = block->next;
+        }
+        else
+        {
+            free_lists_[order] = block->next;
+        }
+        if (block->next)
+        {
+            block->next->prev = block->prev;
+        }
+        --num_free_blocks_[order];
+        SetFreeHead(frame, false);
+    }
+
+    void FrameAllocator::FreeBlockAt(size_t frame, unsigned int order)
+    {
+        num_free_frames_ += static_cast<size_t>(1) << order;
+
+        // merge with the buddy as long as it is a free block of the same order
+        while (order < kMaxOrder)
+        {
+            const size_t buddy = frame ^ (static_cast<size_t>(1) << order);
+            if (buddy >= kMaxFrames
+                    || !IsFreeHead(buddy)
+                    || BlockAt(buddy)->order != order)
+            {
+                break;
+            }
+            Unlink(buddy, order);
+            frame = bitutil::ClearBits(frame, static_cast<size_t>(1) << order);
+            ++order;
+        }
+        Link(frame, order);
+    }
+
+    void FrameAllocator::FreeRange(size_t frame, size_t num_frames)
+    {
+        // split the range into the largest naturally aligned blocks
+        while (num_frames > 0)
+        {
+            unsigned int order = bitutil::BitScanReverse(num_frames);
+            if (frame != 0)
+            {
+                const unsigned int align = bitutil::BitScanForward(frame);
+                order = align < order ? align : order;
+            }
+            order = order < kMaxOrder ? order : kMaxOrder;
+
+            FreeBlockAt(frame, order);
+            frame += static_cast<size_t>(1) << order;
+            num_frames -= static_cast<size_t>(1) << order;
+        }
+    }
+
+    unsigned int FrameAllocator::FindFreeOrder(unsigned int order) const
+    {
+        while (order <= kMaxOrder && free_lists_[order] == nullptr)
+        {
+            ++order;
+        }
+        return order;
+    }
+
+    WithError<uintptr_t> FrameAllocator::Allocate(unsigned int order)
+    {
+        if (order > kMaxOrder)
+        {
+            return {0, errorcode::kInvalidValue};
+        }
+
+        unsigned int k = FindFreeOrder(order);
+        if (k > kMaxOrder && reclaim_ != nullptr && reclaim_() > 0)
+        {
+            k = FindFreeOrder(order);
+        }
+        if (k > kMaxOrder)
+        {
+            return {0, errorcode::kNoEnoughMemory};
+        }
+
+        const auto frame =
+            reinterpret_cast<uintptr_t>(free_lists_[k]) / kBytesPerFrame;
+        Unlink(frame, k);
+
+        // give the upper halves back until the block fits the request
+        while (k > order)
+        {
+            --k;
+            Link(frame + (static_cast<size_t>(1) << k), k);
+        }
+
+        num_free_frames_ -= static_cast<size_t>(1) << order;
+        return {frame * kBytesPerFrame, errorcode::kSuccess};
+    }
+
+    Error FrameAllocator::Free(uintptr_t addr, unsigned int order)
+    {
+        if (order > kMaxOrder)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        const uint64_t block_bytes = kBytesPerFrame << order;
+        if (addr % block_bytes != 0 || addr + block_bytes > kMaxPhysicalMemoryBytes)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        const size_t frame = addr / kBytesPerFrame;
+        if (IsFreeHead(frame))
+        {
+            return errorcode::kInvalidValue; // double free
+        }
+
+        FreeBlockAt(frame, order);
+        return errorcode::kSuccess;
+    }
+
+    WithError<uintptr_t> FrameAllocator::AllocateFrames(size_t num_frames)
+    {
+        if (num_frames == 0)
+        {
+            return {0, errorcode::kInvalidValue};
+        }
+
+        unsigned int order = bitutil::BitScanReverse(num_frames);
+        if ((static_cast<size_t>(1) << order) < num_frames)
+        {
+            ++order;
+        }
+
+        auto block = Allocate(order);
+        if (IsError(block.error))
+        {
+            return block;
+        }
+
+        const size_t frame = block.value / kBytesPerFrame;
+        FreeRange(frame + num_frames, (static_cast<size_t>(1) << order) - num_frames);
+        return block;
+    }
+
+    Error FrameAllocator::FreeFrames(uintptr_t addr, size_t num_frames)
+    {
+        if (addr % kBytesPerFrame != 0
+                || addr + num_frames * kBytesPerFrame > kMaxPhysicalMemoryBytes)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        FreeRange(addr / kBytesPerFrame, num_frames);
+        return errorcode::kSuccess;
+    }
+
+    Error FrameAllocator::AddRange(uintptr_t addr, size_t num_frames)
+    {
+        auto err = FreeFrames(addr, num_frames);
+        if (!IsError(err))
+        {
+            num_total_frames_ += num_frames;
+        }
+        return err;
+    }
+}
@@ -4,71 +4,787 @@
 
 #include "graphics.hpp"
 
-#include <stddef.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#include "bitutil.hpp"
 
 namespace bitnos::graphics
 {
+    namespace
+    {
+        /** @brief ClipSpan clips [pos, pos + len) to [0, limit).
+         *
+         * @param skip  Receives the number of pixels cut from the front
+         * @return false if nothing is left
+         */
+        bool ClipSpan(int& pos, unsigned int& len, unsigned int limit, unsigned int& skip)
+        {
+            skip = 0;
+            if (pos < 0)
+            {
+                skip = static_cast<unsigned int>(-pos);
+                if (len <= skip)
+                {
+                    return false;
+                }
+                len -= skip;
+                pos = 0;
+            }
+            if (static_cast<unsigned int>(pos) >= limit)
+            {
+                return false;
+            }
+            if (len > limit - pos)
+            {
+                len = limit - pos;
+            }
+            return len > 0;
+        }
+    }
+
+    BitMaskFormat::Channel BitMaskFormat::MakeChannel(uint32_t mask)
+    {
+        if (mask == 0)
+        {
+            return {8, 0};
+        }
+
+        const int shift = bitutil::BitScanForward(mask);
+        const int width = bitutil::BitScanReverse(mask) - shift + 1;
+        if (width >= 8)
+        {
+            // keep the 8 bits at the top of a wider channel
+            return {0, static_cast<uint8_t>(shift + width - 8)};
+        }
+        return {static_cast<uint8_t>(8 - width), static_cast<uint8_t>(shift)};
+    }
 
-    void PixelWriterRedGreenBlueReserved8BitPerColor::Write(
-        const Point& position, const Color& color)
+    void FillPixels32(uint32_t* dst, uint32_t value, size_t n)
     {
-        auto p = reinterpret_cast<uint8_t*>(CalcPixelAddr(position));
-        p[0] = color.r;
-        p[1] = color.g;
-        p[2] = color.b;
+        if (value == (value & 0xffu) * 0x01010101u)
+        {
+            // black, white and grays: memset picks the fastest store
+            memset(dst, value & 0xffu, n * sizeof(uint32_t));
+            return;
+        }
+
+        for (; n > 0 && (reinterpret_cast<uintptr_t>(dst) & 15); --n)
+        {
+            *dst++ = value;
+        }
+
+        const __m128i v = _mm_set1_epi32(static_cast<int>(value));
+        for (; n >= 16; n -= 16, dst += 16)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst), v);
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + 4), v);
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + 8), v);
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + 12), v);
+        }
+        for (; n >= 4; n -= 4, dst += 4)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst), v);
+        }
+        for (; n > 0; --n)
+        {
+            *dst++ = value;
+        }
     }
 
-    void PixelWriterBlueGreenRedReserved8BitPerColor::Write(
-        const Point& position, const Color& color)
+    void PixelWriter::FillEncoded(Point position, RectSize size, uint32_t value)
     {
-        auto p = reinterpret_cast<uint8_t*>(CalcPixelAddr(position));
-        p[0] = color.b;
-        p[1] = color.g;
-        p[2] = color.r;
+        unsigned int skip_x, skip_y;
+        if (!ClipSpan(position.x, size.width, resolution_.width, skip_x) ||
+            !ClipSpan(position.y, size.height, resolution_.height, skip_y))
+        {
+            return;
+        }
+
+        auto dst = PixelAddr(position);
+        if (size.width == pixels_per_scan_line_)
+        {
+            // whole scan lines are contiguous
+            FillPixels32(dst, value, static_cast<size_t>(size.width) * size.height);
+            return;
+        }
+
+        for (unsigned int y = 0; y < size.height; ++y)
+        {
+            FillPixels32(dst, value, size.width);
+            dst += pixels_per_scan_line_;
+        }
     }
 
-    void DrawAscii(PixelWriter& w, const Point& position, char ch)
+    void PixelWriter::BlitEncoded(Point position, const uint32_t* src,
+                                  size_t src_stride, RectSize size)
     {
-        unsigned char *p = _binary_hankaku_bin_start +
-            16 * static_cast<size_t>(ch);
-        auto PutPixel = [&](const Point& diff, const Color& color)
+        unsigned int skip_x, skip_y;
+        if (!ClipSpan(position.x, size.width, resolution_.width, skip_x) ||
+            !ClipSpan(position.y, size.height, resolution_.height, skip_y))
         {
-            w.Write(position + diff, color);
+            return;
+        }
+
+        src += src_stride * skip_y + skip_x;
+        auto dst = PixelAddr(position);
+        for (unsigned int y = 0; y < size.height; ++y)
+        {
+            memcpy(dst, src, size.width * sizeof(uint32_t));
+            dst += pixels_per_scan_line_;
+            src += src_stride;
+        }
+    }
+
+    namespace
+    {
+        int Min(int a, int b)
+        {
+            return a < b ? a : b;
+        }
+
+        int Max(int a, int b)
+        {
+            return a > b ? a : b;
+        }
+    }
+
+    void DirtyRegions::Add(const Point& position, const RectSize& size, const RectSize& bounds)
+    {
+        Region r = {
+            Max(position.x, 0),
+            Max(position.y, 0),
+            Min(position.x + static_cast<int>(size.width), static_cast<int>(bounds.width)),
+            Min(position.y + static_cast<int>(size.height), static_cast<int>(bounds.height))
         };
-        const Color kBlack = {0, 0, 0, 0};
+        if (r.x0 >= r.x1 || r.y0 >= r.y1)
+        {
+            return;
+        }
 
-        for (int dy = 0; dy < 16; dy++)
+        auto Touches = [](const Region& a, const Region& b)
+        {
+            return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+        };
+        auto Union = [](const Region& a, const Region& b)
+        {
+            return Region{Min(a.x0, b.x0), Min(a.y0, b.y0), Max(a.x1, b.x1), Max(a.y1, b.y1)};
+        };
+        auto Area = [](const Region& a)
+        {
+            return static_cast<long>(a.x1 - a.x0) * (a.y1 - a.y0);
+        };
+
+        // absorb every region r touches; the grown r may touch more
+        for (int i = 0; i < num_regions_;)
+        {
+            if (Touches(r, regions_[i]))
+            {
+                r = Union(r, regions_[i]);
+                regions_[i] = regions_[--num_regions_];
+                i = 0;
+                continue;
+            }
+            ++i;
+        }
+
+        if (num_regions_ < kMaxRegions)
+        {
+            regions_[num_regions_++] = r;
+            return;
+        }
+
+        // the list is full: merge into the region that grows the least
+        int best = 0;
+        long best_growth = 0;
+        for (int i = 0; i < num_regions_; ++i)
+        {
+            const auto growth = Area(Union(r, regions_[i])) - Area(regions_[i]);
+            if (i == 0 || growth < best_growth)
+            {
+                best = i;
+                best_growth = growth;
+            }
+        }
+        regions_[best] = Union(r, regions_[best]);
+    }
+
+    Layer::Layer(Compositor& compositor, uint32_t* buffer, const RectSize& size)
+        : PixelWriter(reinterpret_cast<uintptr_t>(buffer), size.width, size),
+          compositor_(compositor), buffer_(buffer), position_{0, 0},
+          visible_(false), transparent_(false), transparent_color_(0)
+    {}
+
+    Layer::~Layer()
+    {
+        delete[] buffer_;
+    }
+
+    void Layer::Damage(const Point& position, const RectSize& size)
+    {
+        if (visible_)
+        {
+            compositor_.Damage(position_ + position, size);
+        }
+    }
+
+    uint32_t Layer::Encode(const Color& color)
+    {
+        return compositor_.screen_.Encode(color);
+    }
+
+    void Layer::Write(const Point& position, const Color& color)
+    {
+        if (Contains(position))
+        {
+            *PixelAddr(position) = Encode(color);
+            Damage(position, {1, 1});
+        }
+    }
+
+    void Layer::HLine(const Point& position, unsigned int width, const Color& color)
+    {
+        FillRect(position, {width, 1}, color);
+    }
+
+    void Layer::FillRect(const Point& position, const RectSize& size, const Color& color)
+    {
+        FillEncoded(position, size, Encode(color));
+        Damage(position, size);
+    }
+
+    void Layer::Blit(const Point& position, const uint32_t* src,
+                     size_t src_stride, const RectSize& size)
+    {
+        BlitEncoded(position, src, src_stride, size);
+        Damage(position, size);
+    }
+
+    void Layer::SetTransparentColor(const Color& color)
+    {
+        transparent_ = true;
+        transparent_color_ = Encode(color);
+        Damage({0, 0}, Resolution());
+    }
+
+    Compositor::Compositor(PixelWriter& screen, const Color& background)
+        : screen_(screen), background_(screen.Encode(background)),
+          layers_{}, num_layers_(0),
+          line_(new uint32_t[screen.Resolution().width])
+    {}
+
+    Compositor::~Compositor()
+    {
+        for (int i = 0; i < num_layers_; ++i)
+        {
+            delete layers_[i];
+        }
+        delete[] line_;
+    }
+
+    Layer* Compositor::NewLayer(const RectSize& size)
+    {
+        if (num_layers_ == kMaxLayers || line_ == nullptr)
+        {
+            return nullptr;
+        }
+
+        const size_t num_pixels = static_cast<size_t>(size.width) * size.height;
+        auto buffer = new uint32_t[num_pixels];
+        if (buffer == nullptr)
+        {
+            return nullptr;
+        }
+        FillPixels32(buffer, background_, num_pixels);
+        auto layer = new Layer(*this, buffer, size);
+        if (layer == nullptr)
+        {
+            delete[] buffer;
+            return nullptr;
+        }
+
+        layers_[num_layers_++] = layer;
+        return layer;
+    }
+
+    void Compositor::MoveLayer(Layer& layer, const Point& position)
+    {
+        layer.Damage({0, 0}, layer.Resolution());
+        layer.position_ = position;
+        layer.Damage({0, 0}, layer.Resolution());
+    }
+
+    void Compositor::SetVisible(Layer& layer, bool visible)
+    {
+        if (layer.visible_ != visible)
+        {
+            layer.visible_ = visible;
+            Damage(layer.position_, layer.Resolution());
+        }
+    }
+
+    void Compositor::Damage(const Point& position, const RectSize& size)
+    {
+        damage_.Add(position, size, screen_.Resolution());
+    }
+
+    void Compositor::ComposeLine(int y, int x0, int x1, int top, uint32_t* out)
+    {
+        // the topmost layer at or below top overlapping the span
+        int i = top;
+        int lx0 = 0, lx1 = 0;
+        for (; i >= 0; --i)
+        {
+            const auto layer = layers_[i];
+            if (!layer->visible_)
+            {
+                continue;
+            }
+            const auto pos = layer->position_;
+            const auto size = layer->Resolution();
+            if (y < pos.y || pos.y + static_cast<int>(size.height) <= y)
+            {
+                continue;
+            }
+            lx0 = Max(x0, pos.x);
+            lx1 = Min(x1, pos.x + static_cast<int>(size.width));
+            if (lx0 < lx1)
+            {
+                break;
+            }
+        }
+
+        if (i < 0)
+        {
+            FillPixels32(out + x0, background_, x1 - x0);
+            return;
+        }
+
+        const auto layer = layers_[i];
+        const auto src = layer->buffer_
+            + static_cast<size_t>(layer->Resolution().width) * (y - layer->position_.y)
+            - layer->position_.x;
+        if (layer->transparent_)
         {
-            auto pixels = p[dy];
-            for (int dx = 0; dx < 8; dx++)
+            ComposeLine(y, x0, x1, i - 1, out);
+            for (int x = lx0; x < lx1; ++x)
             {
-                if (pixels & 0x80u)
+                if (src[x] != layer->transparent_color_)
                 {
-                    PutPixel({dx, dy}, kBlack);
+                    out[x] = src[x];
                 }
-                pixels <<= 1;
             }
+            return;
+        }
+
+        // layers below only show around this one
+        memcpy(out + lx0, src + lx0, sizeof(uint32_t) * (lx1 - lx0));
+        if (x0 < lx0)
+        {
+            ComposeLine(y, x0, lx0, i - 1, out);
+        }
+        if (lx1 < x1)
+        {
+            ComposeLine(y, lx1, x1, i - 1, out);
         }
     }
 
-    void DrawRect(
-        PixelWriter& w,
-        const Point& position,
-        const RectSize& size,
-        const Color& color)
+    void Compositor::Compose()
     {
-        auto PutPixel = [&](const Point& diff)
+        if (line_ == nullptr)
+        {
+            return;
+        }
+
+        for (int i = 0; i < damage_.Size(); ++i)
         {
-            w.Write(position + diff, color);
+            const auto& r = damage_[i];
+            const RectSize line_size = {static_cast<unsigned int>(r.x1 - r.x0), 1};
+            for (int y = r.y0; y < r.y1; ++y)
+            {
+                ComposeLine(y, r.x0, r.x1, num_layers_ - 1, line_);
+                screen_.Blit({r.x0, y}, line_ + r.x0, 0, line_size);
+            }
+        }
+        damage_.Clear();
+    }
+
+    namespace
+    {
+        bool operator ==(const Color& lhs, const Color& rhs)
+        {
+            return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b;
+        }
+
+        const size_t kGlyphPixels = GlyphCache::kGlyphWidth * GlyphCache::kGlyphHeight;
+    }
+
+    GlyphCache::GlyphCache(PixelWriter& writer, const Color& fg, const Color& bg)
+        : writer_(writer), fg_(fg), bg_(bg),
+          pixels_(new uint32_t[(kNumGlyphs + kMaxStringLength) * kGlyphPixels]),
+          strip_(pixels_ ? pixels_ + kNumGlyphs * kGlyphPixels : nullptr)
+    {
+        Render();
+    }
+
+    GlyphCache::~GlyphCache()
+    {
+        delete[] pixels_;
+    }
+
+    void GlyphCache::SetColors(const Color& fg, const Color& bg)
+    {
+        if (fg == fg_ && bg == bg_)
+        {
+            return;
+        }
+        fg_ = fg;
+        bg_ = bg;
+        Render();
+    }
+
+    void GlyphCache::Render()
+    {
+        if (pixels_ == nullptr)
+        {
+            return;
+        }
+
+        const uint32_t fg = writer_.Encode(fg_);
+        const uint32_t bg = writer_.Encode(bg_);
+        auto dst = pixels_;
+        for (int ch = 0; ch < kNumGlyphs; ++ch)
+        {
+            const unsigned char *font = _binary_hankaku_bin_start + kGlyphHeight * ch;
+            for (int dy = 0; dy < kGlyphHeight; ++dy)
+            {
+                for (int dx = 0; dx < kGlyphWidth; ++dx)
+                {
+                    *dst++ = (font[dy] << dx) & 0x80u ? fg : bg;
+                }
+            }
+        }
+    }
+
+    void GlyphCache::Draw(const Point& position, char ch)
+    {
+        if (pixels_ == nullptr)
+        {
+            // no memory for the cache: draw from the font bitmap
+            writer_.FillRect(position, {kGlyphWidth, kGlyphHeight}, bg_);
+            DrawAscii(writer_, position, ch, fg_);
+            return;
+        }
+
+        const auto index = static_cast<unsigned char>(ch);
+        writer_.Blit(position, pixels_ + kGlyphPixels * index, kGlyphWidth,
+                     {kGlyphWidth, kGlyphHeight});
+    }
+
+    void GlyphCache::DrawString(const Point& position, const char* s, size_t len)
+    {
+        if (pixels_ == nullptr)
+        {
+            for (size_t i = 0; i < len; ++i)
+            {
+                Draw(position + Point{static_cast<int>(kGlyphWidth * i), 0}, s[i]);
+            }
+            return;
+        }
+
+        Point pos = position;
+        while (len > 0)
+        {
+            const size_t n = len < kMaxStringLength ? len : kMaxStringLength;
+            const size_t stride = kGlyphWidth * n;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const auto glyph = pixels_ + kGlyphPixels * static_cast<unsigned char>(s[i]);
+                for (int dy = 0; dy < kGlyphHeight; ++dy)
+                {
+                    memcpy(strip_ + stride * dy + kGlyphWidth * i,
+                           glyph + kGlyphWidth * dy, kGlyphWidth * sizeof(uint32_t));
+                }
+            }
+            writer_.Blit(pos, strip_, stride,
+                         {static_cast<unsigned int>(stride), kGlyphHeight});
+
+            pos.x += stride;
+            s += n;
+            len -= n;
+        }
+    }
+
+    bool IsFullWidth(char32_t code)
+    {
+        static const char32_t kRanges[][2] = {
+            {0x1100, 0x115f}, // Hangul Jamo
+            {0x2e80, 0x303e}, // CJK radicals, symbols and punctuation
+            {0x3041, 0x33ff}, // kana and CJK compatibility
+            {0x3400, 0x4dbf}, // CJK extension A
+            {0x4e00, 0x9fff}, // CJK unified ideographs
+            {0xa000, 0xa4cf}, // Yi
+            {0xac00, 0xd7a3}, // Hangul syllables
+            {0xf900, 0xfaff}, // CJK compatibility ideographs
+            {0xfe30, 0xfe4f}, // CJK compatibility forms
+            {0xff00, 0xff60}, // fullwidth forms
+            {0xffe0, 0xffe6}, // fullwidth signs
+        };
+
+        if (code < kRanges[0][0])
+        {
+            return false;
+        }
+        for (const auto& range : kRanges)
+        {
+            if (range[0] <= code && code <= range[1])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const uint8_t* FindFullWidthGlyph(char32_t code)
+    {
+        const size_t kBytesPerGlyph = 32;
+        const auto atlas = _binary_fullwidth_bin_start;
+        const size_t atlas_size = _binary_fullwidth_bin_end - _binary_fullwidth_bin_start;
+        if (atlas_size < 4)
+        {
+            return nullptr;
+        }
+
+        // the atlas is not aligned, so read it with memcpy
+        auto Read32 = [&](size_t offset)
+        {
+            uint32_t value;
+            memcpy(&value, atlas + offset, sizeof(value));
+            return value;
         };
 
-        for (int dy = 0; dy < size.height; dy++)
+        const uint32_t num_glyphs = Read32(0);
+        if (atlas_size < 4 + (4 + kBytesPerGlyph) * static_cast<size_t>(num_glyphs))
         {
-            for (int dx = 0; dx < size.width; dx++)
+            return nullptr;
+        }
+
+        size_t lo = 0, hi = num_glyphs;
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            const auto mid_code = Read32(4 + 4 * mid);
+            if (mid_code == code)
+            {
+                return atlas + 4 + 4 * num_glyphs + kBytesPerGlyph * mid;
+            }
+            if (mid_code < code)
+            {
+                lo = mid + 1;
+            }
+            else
             {
-                PutPixel({dx, dy});
+                hi = mid;
             }
         }
+        return nullptr;
+    }
+
+    WideGlyphCache::WideGlyphCache(PixelWriter& writer, const Color& fg, const Color& bg)
+        : writer_(writer), fg_(fg), bg_(bg),
+          pixels_(new uint32_t[kNumEntries * kGlyphWidth * kGlyphHeight]),
+          num_hits_(0), num_misses_(0)
+    {
+        Clear();
+    }
+
+    WideGlyphCache::~WideGlyphCache()
+    {
+        delete[] pixels_;
+    }
+
+    void WideGlyphCache::Clear()
+    {
+        for (auto& bucket : buckets_)
+        {
+            bucket = kNone;
+        }
+        head_ = tail_ = kNone;
+        num_entries_ = 0;
+    }
+
+    void WideGlyphCache::SetColors(const Color& fg, const Color& bg)
+    {
+        if (fg == fg_ && bg == bg_)
+        {
+            return;
+        }
+        fg_ = fg;
+        bg_ = bg;
+        Clear();
+    }
+
+    int16_t WideGlyphCache::Find(char32_t code)
+    {
+        auto i = buckets_[code & (kNumBuckets - 1)];
+        while (i != kNone && entries_[i].code != code)
+        {
+            i = entries_[i].hash_next;
+        }
+        return i;
+    }
+
+    void WideGlyphCache::Unlink(int16_t index)
+    {
+        auto& e = entries_[index];
+        if (e.prev == kNone)
+        {
+            head_ = e.next;
+        }
+        else
+        {
+            entries_[e.prev].next = e.next;
+        }
+        if (e.next == kNone)
+        {
+            tail_ = e.prev;
+        }
+        else
+        {
+            entries_[e.next].prev = e.prev;
+        }
+    }
+
+    void WideGlyphCache::PushFront(int16_t index)
+    {
+        auto& e = entries_[index];
+        e.prev = kNone;
+        e.next = head_;
+        if (head_ == kNone)
+        {
+            tail_ = index;
+        }
+        else
+        {
+            entries_[head_].prev = index;
+        }
+        head_ = index;
+    }
+
+    int16_t WideGlyphCache::Insert(char32_t code)
+    {
+        int16_t index;
+        if (num_entries_ < kNumEntries)
+        {
+            index = num_entries_++;
+        }
+        else
+        {
+            // evict the least recently used glyph
+            index = tail_;
+            Unlink(index);
+            auto p = &buckets_[entries_[index].code & (kNumBuckets - 1)];
+            while (*p != index)
+            {
+                p = &entries_[*p].hash_next;
+            }
+            *p = entries_[index].hash_next;
+        }
+
+        auto& bucket = buckets_[code & (kNumBuckets - 1)];
+        entries_[index].code = code;
+        entries_[index].hash_next = bucket;
+        bucket = index;
+        PushFront(index);
+        Render(index);
+        return index;
+    }
+
+    void WideGlyphCache::Render(int16_t index)
+    {
+        const uint32_t fg = writer_.Encode(fg_);
+        const uint32_t bg = writer_.Encode(bg_);
+        auto dst = pixels_ + kGlyphWidth * kGlyphHeight * index;
+        const auto glyph = FindFullWidthGlyph(entries_[index].code);
+        for (int dy = 0; dy < kGlyphHeight; ++dy)
+        {
+            unsigned int bits;
+            if (glyph)
+            {
+                bits = glyph[2 * dy] << 8 | glyph[2 * dy + 1];
+            }
+            else
+            {
+                // a box for characters missing from the atlas
+                bits = (dy == 1 || dy == kGlyphHeight - 2) ? 0x7ffeu
+                    : (1 < dy && dy < kGlyphHeight - 2) ? 0x4002u : 0;
+            }
+            for (int dx = 0; dx < kGlyphWidth; ++dx)
+            {
+                *dst++ = (bits << dx) & 0x8000u ? fg : bg;
+            }
+        }
+    }
+
+    void WideGlyphCache::Draw(const Point& position, char32_t code)
+    {
+        if (pixels_ == nullptr)
+        {
+            writer_.FillRect(position, {kGlyphWidth, kGlyphHeight}, bg_);
+            return;
+        }
+
+        auto index = Find(code);
+        if (index == kNone)
+        {
+            ++num_misses_;
+            index = Insert(code);
+        }
+        else
+        {
+            ++num_hits_;
+            Unlink(index);
+            PushFront(index);
+        }
+
+        writer_.Blit(position, pixels_ + kGlyphWidth * kGlyphHeight * index,
+                     kGlyphWidth, {kGlyphWidth, kGlyphHeight});
+    }
+
+    void DrawAscii(PixelWriter& w, const Point& position, char ch, const Color& color)
+    {
+        unsigned char *p = _binary_hankaku_bin_start +
+            16 * static_cast<size_t>(static_cast<unsigned char>(ch));
+
+        // draw each run of set bits as one horizontal line
+        for (int dy = 0; dy < 16; dy++)
+        {
+            unsigned int pixels = p[dy];
+            int dx = 0;
+            while (pixels)
+            {
+                for (; (pixels & 0x80u) == 0; pixels = (pixels << 1) & 0xffu)
+                {
+                    ++dx;
+                }
+                unsigned int run = 0;
+                for (; pixels & 0x80u; pixels = (pixels << 1) & 0xffu)
+                {
+                    ++run;
+                }
+                w.HLine(position + Point{dx, dy}, run, color);
+                dx += run;
+            }
+        }
+    }
+
+    void DrawRect(
+        PixelWriter& w,
+        const Point& position,
+        const RectSize& size,
+        const Color& color)
+    {
+        w.FillRect(position, size, color);
     }
 
 }
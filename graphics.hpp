@@ -1,6 +1,7 @@
 #ifndef GRAPHICS_HPP_
 #define GRAPHICS_HPP_
 
+#include <stddef.h>
 #include <stdint.h>
 #include "bootparam.h"
 
@@ -8,6 +9,10 @@ extern unsigned char _binary_hankaku_bin_start[];
 extern unsigned char _binary_hankaku_bin_end[];
 extern unsigned char _binary_hankaku_bin_size[];
 
+// full-width glyph atlas generated by mkatlas.py
+extern unsigned char _binary_fullwidth_bin_start[];
+extern unsigned char _binary_fullwidth_bin_end[];
+
 namespace bitnos::graphics
 {
     struct Point
@@ -43,24 +48,103 @@ namespace bitnos::graphics
         uint8_t r, g, b, a;
     };
 
+    /** @brief PixelFormat32 is a 32 bit per pixel format whose red, green
+     * and blue channels are at the given bit offsets of a little endian word.
+     */
+    template <unsigned int RedShift, unsigned int GreenShift, unsigned int BlueShift>
+    struct PixelFormat32
+    {
+        static uint32_t Encode(const Color& color)
+        {
+            return static_cast<uint32_t>(color.r) << RedShift
+                | static_cast<uint32_t>(color.g) << GreenShift
+                | static_cast<uint32_t>(color.b) << BlueShift;
+        }
+    };
+
+    using RGBXFormat = PixelFormat32<0, 8, 16>;
+    using BGRXFormat = PixelFormat32<16, 8, 0>;
+
+    /** @brief BitMaskFormat is a 32 bit per pixel format described by a
+     * mask per channel, such as a GOP PixelBitMask mode.
+     *
+     * The shift of each channel is derived from its mask once, so encoding
+     * a color costs a few shifts.
+     */
+    class BitMaskFormat
+    {
+        struct Channel
+        {
+            uint8_t right, left; // bits = (value >> right) << left
+        };
+
+        Channel red_, green_, blue_;
+
+        static Channel MakeChannel(uint32_t mask);
+
+        static uint32_t EncodeChannel(const Channel& ch, uint8_t value)
+        {
+            return static_cast<uint32_t>(value >> ch.right) << ch.left;
+        }
+
+    public:
+        explicit BitMaskFormat(const GraphicPixelBitmask& mask)
+            : red_(MakeChannel(mask.RedMask)),
+              green_(MakeChannel(mask.GreenMask)),
+              blue_(MakeChannel(mask.BlueMask))
+        {}
+
+        uint32_t Encode(const Color& color) const
+        {
+            return EncodeChannel(red_, color.r)
+                | EncodeChannel(green_, color.g)
+                | EncodeChannel(blue_, color.b);
+        }
+    };
+
+    /** @brief FillPixels32 stores value to n consecutive 32 bit pixels.
+     */
+    void FillPixels32(uint32_t* dst, uint32_t value, size_t n);
+
+    /** @brief PixelWriter draws to a 32 bit per pixel frame buffer.
+     *
+     * Drawing is done a span at a time: only the pixel encoding depends on
+     * the pixel format, and it is computed once per span by the subclass.
+     * Every operation clips to the screen.
+     */
     class PixelWriter
     {
         const uintptr_t frame_buffer_base_;
         const uint32_t pixels_per_scan_line_;
-        const uint8_t bytes_per_pixel_;
+        const RectSize resolution_;
 
     protected:
-        uintptr_t CalcPixelAddr(const Point& pixel)
+        uint32_t* PixelAddr(const Point& pixel)
+        {
+            return reinterpret_cast<uint32_t*>(frame_buffer_base_) +
+                static_cast<size_t>(pixels_per_scan_line_) * pixel.y + pixel.x;
+        }
+
+        bool Contains(const Point& pixel) const
         {
-            return frame_buffer_base_ +
-                bytes_per_pixel_ * (pixels_per_scan_line_ * pixel.y + pixel.x);
+            return 0 <= pixel.x && static_cast<unsigned int>(pixel.x) < resolution_.width
+                && 0 <= pixel.y && static_cast<unsigned int>(pixel.y) < resolution_.height;
         }
 
+        void FillEncoded(Point position, RectSize size, uint32_t value);
+        void BlitEncoded(Point position, const uint32_t* src,
+                         size_t src_stride, RectSize size);
+
     public:
-        PixelWriter(uintptr_t frame_buffer_base, uint32_t pixels_per_scan_line, uint32_t bytes_per_pixel)
+        PixelWriter(uintptr_t frame_buffer_base, uint32_t pixels_per_scan_line,
+                    const RectSize& resolution)
             : frame_buffer_base_(frame_buffer_base),
               pixels_per_scan_line_(pixels_per_scan_line),
-              bytes_per_pixel_(bytes_per_pixel)
+              resolution_(resolution)
+        {}
+        PixelWriter(const GraphicMode* mode)
+            : PixelWriter(mode->frame_buffer_base, mode->pixels_per_scan_line,
+                          {mode->horizontal_resolution, mode->vertical_resolution})
         {}
         virtual ~PixelWriter() = default;
         PixelWriter(const PixelWriter&) = delete;
@@ -68,27 +152,332 @@ namespace bitnos::graphics
         PixelWriter(PixelWriter&&) = delete;
         PixelWriter& operator =(PixelWriter&&) = delete;
 
+        RectSize Resolution() const
+        {
+            return resolution_;
+        }
+
+        /** @brief Encode converts color to a pixel value of this writer's format. */
+        virtual uint32_t Encode(const Color& color) = 0;
+
         virtual void Write(const Point& position, const Color& color) = 0;
+
+        /** @brief HLine fills width pixels to the right of position. */
+        virtual void HLine(const Point& position, unsigned int width, const Color& color) = 0;
+
+        virtual void FillRect(const Point& position, const RectSize& size, const Color& color) = 0;
+
+        /** @brief Blit copies a rectangle of pixels encoded by Encode().
+         *
+         * @param position  Top left pixel of the destination
+         * @param src  Top left pixel of the source
+         * @param src_stride  Number of pixels between source rows
+         * @param size  Size of the rectangle
+         */
+        virtual void Blit(const Point& position, const uint32_t* src,
+                          size_t src_stride, const RectSize& size) = 0;
     };
 
-    class PixelWriterRedGreenBlueReserved8BitPerColor : public PixelWriter
+    /** @brief FrameBufferWriter is a PixelWriter specialized for Format.
+     *
+     * Format::Encode is inlined, so no virtual call is made per pixel.
+     */
+    template <class Format>
+    class FrameBufferWriter : public PixelWriter
     {
+        const Format format_;
+
     public:
-        PixelWriterRedGreenBlueReserved8BitPerColor(const GraphicMode *mode)
-            : PixelWriter(mode->frame_buffer_base, mode->pixels_per_scan_line, 4)
+        FrameBufferWriter(const GraphicMode* mode, const Format& format = Format())
+            : PixelWriter(mode), format_(format)
         {}
 
-        virtual void Write(const Point& position, const Color& color);
+        uint32_t Encode(const Color& color) override
+        {
+            return format_.Encode(color);
+        }
+
+        void Write(const Point& position, const Color& color) override
+        {
+            if (Contains(position))
+            {
+                *PixelAddr(position) = format_.Encode(color);
+            }
+        }
+
+        void HLine(const Point& position, unsigned int width, const Color& color) override
+        {
+            FillEncoded(position, {width, 1}, format_.Encode(color));
+        }
+
+        void FillRect(const Point& position, const RectSize& size, const Color& color) override
+        {
+            FillEncoded(position, size, format_.Encode(color));
+        }
+
+        void Blit(const Point& position, const uint32_t* src,
+                  size_t src_stride, const RectSize& size) override
+        {
+            BlitEncoded(position, src, src_stride, size);
+        }
+    };
+
+    using PixelWriterRedGreenBlueReserved8BitPerColor = FrameBufferWriter<RGBXFormat>;
+    using PixelWriterBlueGreenRedReserved8BitPerColor = FrameBufferWriter<BGRXFormat>;
+    using PixelWriterBitMask = FrameBufferWriter<BitMaskFormat>;
+
+    /** @brief ScrollableDisplay is a display showing a screen-sized window
+     * of a taller frame buffer.
+     */
+    class ScrollableDisplay
+    {
+    public:
+        virtual ~ScrollableDisplay() = default;
+
+        /** @brief VirtualHeight returns the height of the frame buffer. */
+        virtual unsigned int VirtualHeight() const = 0;
+
+        /** @brief SetYOffset shows the frame buffer from line y. */
+        virtual void SetYOffset(unsigned int y) = 0;
     };
 
-    class PixelWriterBlueGreenRedReserved8BitPerColor : public PixelWriter
+    /** @brief DirtyRegions is a short list of rectangles to be redrawn.
+     *
+     * An added rectangle absorbs every region it overlaps or touches.
+     * When the list is full, it is merged into the region that grows the
+     * least, so the list never needs memory and stays short.
+     */
+    class DirtyRegions
     {
     public:
-        PixelWriterBlueGreenRedReserved8BitPerColor(const GraphicMode *mode)
-            : PixelWriter(mode->frame_buffer_base, mode->pixels_per_scan_line, 4)
+        static const int kMaxRegions = 8;
+
+        struct Region
+        {
+            int x0, y0, x1, y1; // [x0, x1) x [y0, y1)
+        };
+
+        DirtyRegions()
+            : num_regions_(0)
         {}
 
-        virtual void Write(const Point& position, const Color& color);
+        /** @brief Add adds a rectangle clipped to [0, 0) - bounds. */
+        void Add(const Point& position, const RectSize& size, const RectSize& bounds);
+
+        int Size() const
+        {
+            return num_regions_;
+        }
+
+        const Region& operator [](int i) const
+        {
+            return regions_[i];
+        }
+
+        void Clear()
+        {
+            num_regions_ = 0;
+        }
+
+    private:
+        Region regions_[kMaxRegions];
+        int num_regions_;
+    };
+
+    class Compositor;
+
+    /** @brief Layer is a rectangle of pixels which a Compositor stacks on
+     * the screen.
+     *
+     * A layer is drawn like the screen, in coordinates relative to its top
+     * left corner, and reports the drawn areas to its compositor.
+     * Pixels of the transparent color, if one is set, show the layers below.
+     */
+    class Layer : public PixelWriter
+    {
+        friend class Compositor;
+
+        Compositor& compositor_;
+        uint32_t* const buffer_;
+        Point position_;
+        bool visible_;
+        bool transparent_;
+        uint32_t transparent_color_;
+
+        void Damage(const Point& position, const RectSize& size);
+
+    public:
+        Layer(Compositor& compositor, uint32_t* buffer, const RectSize& size);
+        ~Layer();
+
+        uint32_t Encode(const Color& color) override;
+        void Write(const Point& position, const Color& color) override;
+        void HLine(const Point& position, unsigned int width, const Color& color) override;
+        void FillRect(const Point& position, const RectSize& size, const Color& color) override;
+        void Blit(const Point& position, const uint32_t* src,
+                  size_t src_stride, const RectSize& size) override;
+
+        Point Position() const
+        {
+            return position_;
+        }
+
+        /** @brief SetTransparentColor makes pixels of color show through. */
+        void SetTransparentColor(const Color& color);
+    };
+
+    /** @brief Compositor draws z-ordered layers to the screen.
+     *
+     * Only damaged regions are recomposed. They are composed a scan line at
+     * a time from the topmost layer down: an opaque layer covering part of
+     * the line hides it from the layers below, which are never read there.
+     */
+    class Compositor
+    {
+        friend class Layer;
+
+    public:
+        static const int kMaxLayers = 8;
+
+        /**
+         * @param screen  Writer to the screen
+         * @param background  Color where no layer is
+         */
+        Compositor(PixelWriter& screen, const Color& background);
+        ~Compositor();
+        Compositor(const Compositor&) = delete;
+        Compositor& operator =(const Compositor&) = delete;
+
+        /** @brief NewLayer makes a hidden layer above the existing ones.
+         *
+         * @return nullptr if there is no memory or too many layers
+         */
+        Layer* NewLayer(const RectSize& size);
+
+        void MoveLayer(Layer& layer, const Point& position);
+        void SetVisible(Layer& layer, bool visible);
+
+        /** @brief Damage marks an area of the screen to be recomposed. */
+        void Damage(const Point& position, const RectSize& size);
+
+        /** @brief Compose redraws the damaged areas to the screen. */
+        void Compose();
+
+    private:
+        PixelWriter& screen_;
+        const uint32_t background_;
+        Layer* layers_[kMaxLayers]; // bottom to top
+        int num_layers_;
+        DirtyRegions damage_;
+        uint32_t* line_;
+
+        void ComposeLine(int y, int x0, int x1, int top, uint32_t* out);
+    };
+
+    /** @brief GlyphCache holds the hankaku font pre-rendered in the pixel
+     * format of a writer and a pair of foreground/background colors.
+     *
+     * Drawing a character is then a 16 row blit of ready-to-store pixels.
+     */
+    class GlyphCache
+    {
+    public:
+        static const int kGlyphWidth = 8;
+        static const int kGlyphHeight = 16;
+        static const int kNumGlyphs = 256;
+        static const int kMaxStringLength = 32; // drawn by one blit
+
+        GlyphCache(PixelWriter& writer, const Color& fg, const Color& bg);
+        ~GlyphCache();
+        GlyphCache(const GlyphCache&) = delete;
+        GlyphCache& operator =(const GlyphCache&) = delete;
+
+        /** @brief SetColors re-renders every glyph if the colors differ. */
+        void SetColors(const Color& fg, const Color& bg);
+
+        /** @brief Draw draws ch with its background. */
+        void Draw(const Point& position, char ch);
+
+        /** @brief DrawString draws len characters from s in a row.
+         * Each kMaxStringLength characters are composed and blitted at once.
+         */
+        void DrawString(const Point& position, const char* s, size_t len);
+
+    private:
+        PixelWriter& writer_;
+        Color fg_, bg_;
+        uint32_t* pixels_;
+        uint32_t* strip_; // composes DrawString, follows the glyphs in pixels_
+
+        void Render();
+    };
+
+    /** @brief IsFullWidth returns true if code takes two columns of text.
+     * The ranges must match mkatlas.py.
+     */
+    bool IsFullWidth(char32_t code);
+
+    /** @brief FindFullWidthGlyph looks code up in the full-width atlas.
+     *
+     * @return 16 rows of 2 bytes, the MSB being the left pixel,
+     *   or nullptr if the atlas has no glyph for code
+     */
+    const uint8_t* FindFullWidthGlyph(char32_t code);
+
+    /** @brief WideGlyphCache keeps recently drawn full-width glyphs
+     * pre-rendered like GlyphCache does for the hankaku font.
+     *
+     * The atlas is too large to render in advance, so a bounded number of
+     * glyphs is kept and the least recently used one is replaced.
+     * Characters without a glyph are drawn as a box.
+     */
+    class WideGlyphCache
+    {
+    public:
+        static const int kGlyphWidth = 16;
+        static const int kGlyphHeight = 16;
+        static const int kNumEntries = 128;
+
+        WideGlyphCache(PixelWriter& writer, const Color& fg, const Color& bg);
+        ~WideGlyphCache();
+        WideGlyphCache(const WideGlyphCache&) = delete;
+        WideGlyphCache& operator =(const WideGlyphCache&) = delete;
+
+        /** @brief SetColors drops every glyph if the colors differ. */
+        void SetColors(const Color& fg, const Color& bg);
+
+        /** @brief Draw draws code with its background. */
+        void Draw(const Point& position, char32_t code);
+
+        size_t NumHits() const { return num_hits_; }
+        size_t NumMisses() const { return num_misses_; }
+
+    private:
+        static const int kNumBuckets = 256; // power of two
+        static const int16_t kNone = -1;
+
+        struct Entry
+        {
+            char32_t code;
+            int16_t prev, next; // toward the most/least recently used
+            int16_t hash_next;
+        };
+
+        PixelWriter& writer_;
+        Color fg_, bg_;
+        uint32_t* pixels_;
+        Entry entries_[kNumEntries];
+        int16_t buckets_[kNumBuckets];
+        int16_t head_, tail_; // most and least recently used
+        int num_entries_;
+        size_t num_hits_, num_misses_;
+
+        void Clear();
+        int16_t Find(char32_t code);
+        int16_t Insert(char32_t code);
+        void Unlink(int16_t index);
+        void PushFront(int16_t index);
+        void Render(int16_t index);
     };
 
     /** @brief DrawAscii draws an ascii character to the given pixel writer.
@@ -97,8 +486,10 @@ namespace bitnos::graphics
      * @param w  Pixel writer to draw a character
      * @param position  Pixel position
      * @param ch  Ascii code
+     * @param color  Draw color; the background is left untouched
      */
-    void DrawAscii(PixelWriter& w, const Point& position, char ch);
+    void DrawAscii(PixelWriter& w, const Point& position, char ch,
+                   const Color& color = {0, 0, 0, 0});
 
     /** @brief DrawRect draws a rectangle to the given pixel writer.
      *
@@ -0,0 +1,87 @@
+#include "heap.hpp"
+
+#include <errno.h>
+#undef errno
+extern "C" int errno;
+
+#include <sys/types.h>
+
+#include "memory.hpp"
+#include "paging.hpp"
+
+namespace
+{
+    using namespace bitnos;
+    using namespace bitnos::memory;
+
+    bool heap_initialized = false;
+    uintptr_t heap_break = kHeapBase;
+    uintptr_t heap_mapped_end = kHeapBase;
+
+    Error MapHeapUpTo(uintptr_t new_break)
+    {
+        while (heap_mapped_end < new_break)
+        {
+            auto frame = frame_allocator->Allocate(kOrder4KiB);
+            if (IsError(frame.error))
+            {
+                return frame.error;
+            }
+            auto err = paging::MapPages(heap_mapped_end, frame.value,
+                kBytesPerFrame, paging::MemoryType::kWriteBack);
+            if (IsError(err))
+            {
+                frame_allocator->Free(frame.value, kOrder4KiB);
+                return err;
+            }
+            heap_mapped_end += kBytesPerFrame;
+        }
+        return errorcode::kSuccess;
+    }
+}
+
+namespace bitnos::memory
+{
+    Error InitializeHeap()
+    {
+        if (!paging::IsPagingInitialized())
+        {
+            return errorcode::kInvalidValue;
+        }
+        heap_initialized = true;
+        return errorcode::kSuccess;
+    }
+
+    HeapStat GetHeapStat()
+    {
+        return {kHeapBase, heap_break - kHeapBase, heap_mapped_end - kHeapBase};
+    }
+}
+
+extern "C" caddr_t sbrk(int incr)
+{
+    if (!heap_initialized)
+    {
+        errno = ENOMEM;
+        return reinterpret_cast<caddr_t>(-1);
+    }
+
+    const auto prev_break = heap_break;
+    const size_t size = heap_break - kHeapBase;
+    if ((incr > 0 && kMaxHeapBytes - size < static_cast<size_t>(incr))
+            || (incr < 0 && size < static_cast<size_t>(-incr)))
+    {
+        errno = ENOMEM;
+        return reinterpret_cast<caddr_t>(-1);
+    }
+
+    // pages below a lowered break stay mapped for later growth
+    if (IsError(MapHeapUpTo(heap_break + incr)))
+    {
+        errno = ENOMEM;
+        return reinterpret_cast<caddr_t>(-1);
+    }
+
+    heap_break += incr;
+    return reinterpret_cast<caddr_t>(prev_break);
+}
@@ -0,0 +1,36 @@
+#ifndef HEAP_HPP_
+#define HEAP_HPP_
+
+/** @file heap.hpp provides the kernel heap region which backs sbrk,
+ * and therefore newlib's malloc and stdio buffers.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "errorcode.hpp"
+
+namespace bitnos::memory
+{
+    // The heap lives above any identity mapped physical memory.
+    const uintptr_t kHeapBase = 0x100000000000u;
+    const size_t kMaxHeapBytes = 1024 * 1024 * 1024;
+
+    struct HeapStat
+    {
+        uintptr_t base;
+        size_t size;   // current break - base
+        size_t mapped; // bytes backed by frames
+    };
+
+    /** @brief InitializeHeap enables the heap region.
+     *
+     * Frames are mapped page by page as sbrk moves the break up,
+     * so paging must be initialized in advance.
+     */
+    Error InitializeHeap();
+
+    HeapStat GetHeapStat();
+}
+
+#endif // HEAP_HPP_
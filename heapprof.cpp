@@ -0,0 +1,234 @@
+#include "heapprof.hpp"
+
+#include <stdio.h>
+
+#include "asmfunc.h"
+
+#ifdef HEAP_PROFILE
+
+namespace
+{
+    using namespace bitnos::heapprof;
+
+    struct Record
+    {
+        void* ptr; // nullptr means an empty slot
+        void* caller;
+        size_t size;
+        uint64_t seq;
+        uint64_t tsc;
+    };
+
+    // open addressing with linear probing, deleted by backward shift
+    Record records[kMaxLiveAllocations];
+    size_t num_records = 0;
+    size_t num_dropped = 0;
+    uint64_t next_seq = 0;
+    uint64_t snapshots[2] = {0, 0};
+
+    size_t Hash(void* ptr)
+    {
+        auto x = reinterpret_cast<uintptr_t>(ptr) >> 4;
+        x *= 0x9e3779b97f4a7c15u;
+        return (x >> 32) % kMaxLiveAllocations;
+    }
+
+    struct CallSite
+    {
+        void* caller;
+        size_t bytes;
+        size_t count;
+    };
+
+    const size_t kMaxCallSites = 512;
+    CallSite call_sites[kMaxCallSites];
+
+    /** Aggregate live records whose seq is in [seq_begin, seq_end)
+     * by call site, and returns the number of call sites.
+     */
+    size_t AggregateCallSites(uint64_t seq_begin, uint64_t seq_end)
+    {
+        size_t num_sites = 0;
+        for (const auto& r : records)
+        {
+            if (r.ptr == nullptr || r.seq < seq_begin || r.seq >= seq_end)
+            {
+                continue;
+            }
+
+            size_t i = 0;
+            while (i < num_sites && call_sites[i].caller != r.caller)
+            {
+                ++i;
+            }
+            if (i == num_sites)
+            {
+                if (num_sites == kMaxCallSites)
+                {
+                    continue;
+                }
+                call_sites[num_sites++] = {r.caller, 0, 0};
+            }
+            call_sites[i].bytes += r.size;
+            ++call_sites[i].count;
+        }
+        return num_sites;
+    }
+
+    template <typename Key>
+    void PrintTop(size_t num_sites, size_t n, Key key)
+    {
+        // selection of the top n; the number of call sites is small
+        bool printed[kMaxCallSites] = {};
+        for (size_t rank = 0; rank < n && rank < num_sites; ++rank)
+        {
+            size_t best = num_sites;
+            for (size_t i = 0; i < num_sites; ++i)
+            {
+                if (!printed[i] && (best == num_sites
+                            || key(call_sites[i]) > key(call_sites[best])))
+                {
+                    best = i;
+                }
+            }
+            printed[best] = true;
+            const auto& site = call_sites[best];
+            printf("  %016lx %10lu bytes %8lu objects\n",
+                reinterpret_cast<uintptr_t>(site.caller),
+                site.bytes, site.count);
+        }
+    }
+}
+
+namespace bitnos::heapprof
+{
+    void RecordAllocation(void* ptr, size_t size, void* caller)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+        if (num_records == kMaxLiveAllocations - 1)
+        {
+            ++num_dropped;
+            return;
+        }
+
+        size_t i = Hash(ptr);
+        while (records[i].ptr != nullptr)
+        {
+            i = (i + 1) % kMaxLiveAllocations;
+        }
+        records[i] = {ptr, caller, size, next_seq++, ReadTSC()};
+        ++num_records;
+    }
+
+    void RecordFree(void* ptr)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+
+        size_t i = Hash(ptr);
+        while (records[i].ptr != ptr)
+        {
+            if (records[i].ptr == nullptr)
+            {
+                return; // dropped or not allocated by operator new
+            }
+            i = (i + 1) % kMaxLiveAllocations;
+        }
+
+        // shift following records back so that probing never sees a hole
+        size_t hole = i;
+        for (size_t j = (i + 1) % kMaxLiveAllocations;
+             records[j].ptr != nullptr;
+             j = (j + 1) % kMaxLiveAllocations)
+        {
+            const size_t home = Hash(records[j].ptr);
+            const bool movable = hole <= j
+                ? (home <= hole || home > j)
+                : (home <= hole && home > j);
+            if (movable)
+            {
+                records[hole] = records[j];
+                hole = j;
+            }
+        }
+        records[hole].ptr = nullptr;
+        --num_records;
+    }
+
+    void TakeSnapshot()
+    {
+        snapshots[0] = snapshots[1];
+        snapshots[1] = next_seq;
+        printf("snapshot at allocation #%lu (%lu live)\n", next_seq, num_records);
+    }
+
+    void PrintTopCallSites(size_t num_sites)
+    {
+        printf("%lu live allocations, %lu dropped\n", num_records, num_dropped);
+        const size_t n = AggregateCallSites(0, next_seq);
+        printf("top call sites by bytes:\n");
+        PrintTop(n, num_sites, [](const CallSite& s) { return s.bytes; });
+        printf("top call sites by count:\n");
+        PrintTop(n, num_sites, [](const CallSite& s) { return s.count; });
+    }
+
+    void PrintLeaks()
+    {
+        uint64_t tsc_begin = 0;
+        size_t num_leaks = 0;
+        for (const auto& r : records)
+        {
+            if (r.ptr != nullptr
+                    && snapshots[0] <= r.seq && r.seq < snapshots[1])
+            {
+                if (num_leaks == 0 || r.tsc < tsc_begin)
+                {
+                    tsc_begin = r.tsc;
+                }
+                ++num_leaks;
+            }
+        }
+
+        printf("%lu allocations between snapshots are still alive\n", num_leaks);
+        if (num_leaks == 0)
+        {
+            return;
+        }
+        printf("oldest one allocated %lu cycles ago\n", ReadTSC() - tsc_begin);
+        const size_t n = AggregateCallSites(snapshots[0], snapshots[1]);
+        PrintTop(n, n, [](const CallSite& s) { return s.bytes; });
+    }
+}
+
+#else // HEAP_PROFILE
+
+namespace bitnos::heapprof
+{
+    void RecordAllocation(void* ptr, size_t size, void* caller)
+    {}
+
+    void RecordFree(void* ptr)
+    {}
+
+    void TakeSnapshot()
+    {
+        printf("heap profiling is disabled (build with HEAP_PROFILE=1)\n");
+    }
+
+    void PrintTopCallSites(size_t num_sites)
+    {
+        printf("heap profiling is disabled (build with HEAP_PROFILE=1)\n");
+    }
+
+    void PrintLeaks()
+    {
+        printf("heap profiling is disabled (build with HEAP_PROFILE=1)\n");
+    }
+}
+
+#endif // HEAP_PROFILE
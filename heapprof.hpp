@@ -0,0 +1,53 @@
+#ifndef HEAPPROF_HPP_
+#define HEAPPROF_HPP_
+
+/** @file heapprof.hpp provides allocation tracking for operator new/delete.
+ *
+ * Tracking is compiled in only when HEAP_PROFILE is defined
+ * (make HEAP_PROFILE=1). Otherwise kEnabled is false, the hooks in
+ * memory.cpp that test it fold away and the functions below just report
+ * that profiling is disabled.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bitnos::heapprof
+{
+#ifdef HEAP_PROFILE
+    const bool kEnabled = true;
+#else
+    const bool kEnabled = false;
+#endif
+
+    const size_t kMaxLiveAllocations = 8192;
+
+    /** @brief RecordAllocation registers a live allocation.
+     *
+     * @param ptr  Allocated pointer (nullptr is ignored)
+     * @param size  Requested size
+     * @param caller  Return address of operator new
+     */
+    void RecordAllocation(void* ptr, size_t size, void* caller);
+
+    /** @brief RecordFree unregisters an allocation.
+     */
+    void RecordFree(void* ptr);
+
+    /** @brief TakeSnapshot marks the current point of the allocation
+     * sequence. The last two snapshots are kept.
+     */
+    void TakeSnapshot();
+
+    /** @brief PrintTopCallSites prints the call sites holding most bytes
+     * and most objects.
+     */
+    void PrintTopCallSites(size_t num_sites);
+
+    /** @brief PrintLeaks prints allocations made between the last two
+     * snapshots which are still alive.
+     */
+    void PrintLeaks();
+}
+
+#endif // HEAPPROF_HPP_
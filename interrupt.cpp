@@ -0,0 +1,150 @@
+#include "interrupt.hpp"
+
+#include "desctable.hpp"
+
+extern "C"
+{
+    // defined in inthandler.s
+    extern const uint64_t interrupt_stubs[bitnos::interrupt::kNumVectors];
+
+    // read by the stubs to decide whether to save SSE state
+    uint8_t interrupt_save_sse[bitnos::interrupt::kNumVectors];
+
+    // XSAVE area size and XCR0 components; 0 makes the stubs use FXSAVE
+    uint64_t interrupt_xsave_size;
+    uint64_t interrupt_xsave_mask;
+
+    void DispatchInterrupt(bitnos::interrupt::InterruptFrame* frame);
+}
+
+namespace bitnos::interrupt
+{
+    namespace
+    {
+        const size_t kNumExceptions = 32;
+        const uint64_t kCR4OSXSAVE = 1u << 18;
+
+        alignas(16) uint64_t idt[2 * kNumVectors];
+        Handler* handlers[kNumVectors];
+        VectorStats stats[kNumVectors];
+
+        inline uint64_t ReadTSC()
+        {
+            uint32_t lo, hi;
+            __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+            return static_cast<uint64_t>(hi) << 32 | lo;
+        }
+
+        uint64_t ReadCR4()
+        {
+            uint64_t cr4;
+            __asm__ volatile("movq %%cr4, %0" : "=r"(cr4));
+            return cr4;
+        }
+
+        uint64_t ReadXCR0()
+        {
+            uint32_t lo, hi;
+            __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            return static_cast<uint64_t>(hi) << 32 | lo;
+        }
+
+        void Halt()
+        {
+            for (;;)
+            {
+                __asm__("cli\n\thlt");
+            }
+        }
+    }
+
+    void Initialize()
+    {
+        const DescriptorTableRegister idtr = {
+            sizeof(idt) - 1, reinterpret_cast<uint64_t>(idt)
+        };
+        const auto cs = GetCS();
+        for (size_t i = 0; i < kNumVectors; ++i)
+        {
+            SetIDTEntry(idtr, i, interrupt_stubs[i], MakeIDTAttr(1, 0, 14, 0), cs);
+        }
+        ResetStats();
+
+        if (ReadCR4() & kCR4OSXSAVE)
+        {
+            // EBX of leaf 0xd is the area size for the components in XCR0
+            uint32_t eax, ebx, ecx, edx;
+            __asm__ volatile("cpuid"
+                             : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                             : "a"(0xd), "c"(0));
+            interrupt_xsave_mask = ReadXCR0();
+            interrupt_xsave_size = ebx;
+        }
+        LoadIDTR(idtr);
+    }
+
+    void SetHandler(uint8_t vector, Handler* handler, bool save_sse)
+    {
+        // an interrupt between the stores must never find a handler needing
+        // SSE with the flag cleared; saving it needlessly is harmless
+        if (save_sse)
+        {
+            interrupt_save_sse[vector] = 1;
+        }
+        __asm__ volatile("" ::: "memory");
+        handlers[vector] = handler;
+        __asm__ volatile("" ::: "memory");
+        interrupt_save_sse[vector] = save_sse;
+    }
+
+    const VectorStats& Stats(uint8_t vector)
+    {
+        return stats[vector];
+    }
+
+    void ResetStats()
+    {
+        for (auto& s : stats)
+        {
+            s = {0, 0, UINT64_MAX, 0};
+        }
+    }
+}
+
+/*
+ * DispatchInterrupt runs before SSE state is saved for most vectors, so it
+ * only works on integers.
+ */
+extern "C" void DispatchInterrupt(bitnos::interrupt::InterruptFrame* frame)
+{
+    using namespace bitnos::interrupt;
+
+    const auto vector = frame->vector;
+    auto handler = handlers[vector];
+    if (handler == nullptr)
+    {
+        ++stats[vector].count;
+        if (vector < kNumExceptions)
+        {
+            // returning would only fault again
+            Halt();
+        }
+        return;
+    }
+
+    const auto start = ReadTSC();
+    handler(*frame);
+    const auto cycles = ReadTSC() - start;
+
+    auto& s = stats[vector];
+    ++s.count;
+    s.total_cycles += cycles;
+    if (cycles < s.min_cycles)
+    {
+        s.min_cycles = cycles;
+    }
+    if (cycles > s.max_cycles)
+    {
+        s.max_cycles = cycles;
+    }
+}
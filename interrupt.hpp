@@ -0,0 +1,72 @@
+#ifndef INTERRUPT_HPP_
+#define INTERRUPT_HPP_
+
+/** @file interrupt.hpp dispatches all 256 interrupt vectors to C++ handlers.
+ *
+ * Each vector has an entry stub in inthandler.s which pushes an error code
+ * (0 for vectors the CPU gives none), the vector number and the caller-saved
+ * registers, then calls DispatchInterrupt with the resulting frame.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bitnos::interrupt
+{
+    const size_t kNumVectors = 256;
+
+    /** @brief InterruptFrame is the stack layout built by the entry stubs.
+     *
+     * Fields up to error_code are pushed by the stub, the rest by the CPU.
+     */
+    struct InterruptFrame
+    {
+        uint64_t r11, r10, r9, r8, rdi, rsi, rdx, rcx, rax;
+        uint64_t vector, error_code;
+        uint64_t rip, cs, rflags, rsp, ss;
+    };
+
+    using Handler = void (InterruptFrame& frame);
+
+    /** @brief VectorStats counts the calls of a vector and the cycles
+     * spent in its handler.
+     */
+    struct VectorStats
+    {
+        uint64_t count;
+        uint64_t total_cycles;
+        uint64_t min_cycles, max_cycles;
+    };
+
+    /** @brief Initialize points a new IDT at the entry stubs and loads it.
+     * Call it after memfunc_init, which may enable AVX state in XCR0.
+     *
+     * Until a handler is set, interrupts are only counted and CPU
+     * exceptions (vectors 0-31) stop the processor.
+     */
+    void Initialize();
+
+    /** @brief SetHandler makes handler serve vector.
+     *
+     * A handler must not touch SSE registers unless save_sse is true,
+     * in which case the stub saves them around the call: with XSAVE for
+     * every component enabled in XCR0 if CR4.OSXSAVE is set (memcpy may
+     * use AVX2), otherwise with FXSAVE. Anything calling into general
+     * kernel code (printf, memcpy, ...) should pass true.
+     *
+     * @param vector  Interrupt vector
+     * @param handler  Handler, or nullptr to remove it
+     * @param save_sse  Whether the stub saves SSE state
+     */
+    void SetHandler(uint8_t vector, Handler* handler, bool save_sse);
+
+    /** @brief Stats returns the statistics of vector.
+     */
+    const VectorStats& Stats(uint8_t vector);
+
+    /** @brief ResetStats clears the statistics of all vectors.
+     */
+    void ResetStats();
+}
+
+#endif // INTERRUPT_HPP_
@@ -1,8 +1,108 @@
 .intel_syntax noprefix
 .code64
 
-.extern Inthandler21
-.global AsmInthandler21
-AsmInthandler21:
-        call    Inthandler21
+.extern DispatchInterrupt
+.extern interrupt_save_sse
+.extern interrupt_xsave_size
+.extern interrupt_xsave_mask
+
+# INTERRUPT_STUB pushes a dummy error code unless the CPU pushes one for vec
+.macro INTERRUPT_STUB vec
+InterruptStub\vec:
+.if !((\vec == 8) || (\vec >= 10 && \vec <= 14) || (\vec == 17) || (\vec == 21) || (\vec == 29) || (\vec == 30))
+        push    0
+.endif
+        push    \vec
+        jmp     InterruptCommon
+.endm
+
+.macro INTERRUPT_STUB_ADDR vec
+        .quad   InterruptStub\vec
+.endm
+
+.altmacro
+
+.set vec, 0
+.rept 256
+        INTERRUPT_STUB %vec
+.set vec, vec + 1
+.endr
+
+# The CPU aligns RSP to 16 bytes before pushing SS, RSP, RFLAGS, CS and RIP.
+# With the error code, the vector and 9 registers the frame is 128 bytes,
+# so RSP stays 16 byte aligned for the call and for FXSAVE.
+InterruptCommon:
+        push    rax
+        push    rcx
+        push    rdx
+        push    rsi
+        push    rdi
+        push    r8
+        push    r9
+        push    r10
+        push    r11
+        cld
+        mov     rdi, rsp
+        mov     rax, [rsp + 72]     # vector
+        lea     rcx, [rip + interrupt_save_sse]
+        cmp     byte ptr [rcx + rax], 0
+        jne     .Lsave_sse
+        call    DispatchInterrupt
+        jmp     .Lrestore
+.Lsave_sse:
+        mov     rcx, [rip + interrupt_xsave_size]
+        test    rcx, rcx
+        jnz     .Lsave_xsave
+        sub     rsp, 512
+        fxsave  [rsp]
+        call    DispatchInterrupt
+        fxrstor [rsp]
+        add     rsp, 512
+        jmp     .Lrestore
+# FXSAVE misses the upper halves of the YMM registers, so with OSXSAVE
+# the state components enabled in XCR0 are saved in a 64 byte aligned area.
+.Lsave_xsave:
+        push    rbp
+        mov     rbp, rsp
+        sub     rsp, rcx
+        and     rsp, -64
+        xor     eax, eax            # XRSTOR faults on a dirty header
+        mov     [rsp + 512], rax
+        mov     [rsp + 520], rax
+        mov     [rsp + 528], rax
+        mov     [rsp + 536], rax
+        mov     [rsp + 544], rax
+        mov     [rsp + 552], rax
+        mov     [rsp + 560], rax
+        mov     [rsp + 568], rax
+        mov     eax, [rip + interrupt_xsave_mask]
+        mov     edx, [rip + interrupt_xsave_mask + 4]
+        xsave   [rsp]
+        call    DispatchInterrupt
+        mov     eax, [rip + interrupt_xsave_mask]
+        mov     edx, [rip + interrupt_xsave_mask + 4]
+        xrstor  [rsp]
+        mov     rsp, rbp
+        pop     rbp
+.Lrestore:
+        pop     r11
+        pop     r10
+        pop     r9
+        pop     r8
+        pop     rdi
+        pop     rsi
+        pop     rdx
+        pop     rcx
+        pop     rax
+        add     rsp, 16             # vector and error code
         iretq
+
+.section .rodata
+.global interrupt_stubs
+.align 8
+interrupt_stubs:
+.set vec, 0
+.rept 256
+        INTERRUPT_STUB_ADDR %vec
+.set vec, vec + 1
+.endr
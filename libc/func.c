@@ -1,31 +1,108 @@
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include "memfunc.h"
+#include "../asmfunc.h"
+
+/* variants for small/medium sizes and for sizes >= MEMFUNC_REP_THRESHOLD */
+static MemcpyFunc *memcpy_small = memcpy_byte;
+static MemcpyFunc *memcpy_large = memcpy_byte;
+static MemsetFunc *memset_small = memset_byte;
+static MemsetFunc *memset_large = memset_byte;
+static int use_nt = 0;
+static const char *variant_name = "byte";
+
+#define CR4_OSXSAVE (1u << 18)
+#define XCR0_AVX_STATE 0x7u /* x87, SSE and AVX */
+
+static int cpu_has(uint32_t leaf, uint32_t subleaf, int reg_index, int bit)
+{
+    uint32_t regs[4];
+    CpuId(leaf & 0x80000000u, 0, regs);
+    if (regs[0] < leaf)
+    {
+        return 0;
+    }
+    CpuId(leaf, subleaf, regs);
+    return (regs[reg_index] >> bit) & 1u;
+}
+
+static int enable_avx(void)
+{
+    if (!cpu_has(1, 0, 2, 26) /* XSAVE */ || !cpu_has(1, 0, 2, 28) /* AVX */)
+    {
+        return 0;
+    }
+
+    SetCR4(GetCR4() | CR4_OSXSAVE);
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    lo |= XCR0_AVX_STATE;
+    __asm__ volatile("xsetbv" : : "a"(lo), "d"(hi), "c"(0));
+    return 1;
+}
+
+void memfunc_init(void)
+{
+    const int erms = cpu_has(7, 0, 1, 9);
+    const int avx2 = cpu_has(7, 0, 1, 5) && enable_avx();
+
+    memcpy_small = avx2 ? memcpy_avx2 : memcpy_sse2;
+    memset_small = avx2 ? memset_avx2 : memset_sse2;
+    memcpy_large = erms ? memcpy_erms : memcpy_small;
+    memset_large = erms ? memset_erms : memset_small;
+    use_nt = 1;
+
+    variant_name = avx2 ? (erms ? "avx2+erms+nt" : "avx2+nt")
+                        : (erms ? "sse2+erms+nt" : "sse2+nt");
+}
+
+const char *memfunc_variant(void)
+{
+    return variant_name;
+}
+
 void *memcpy(void *dest, const void *src, size_t n)
 {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
-    for (size_t i = 0; i < n; i++)
+    if (n < MEMFUNC_REP_THRESHOLD)
+    {
+        return memcpy_small(dest, src, n);
+    }
+    if (use_nt && n >= MEMFUNC_NT_THRESHOLD)
     {
-        *d++ = *s++;
+        return memcpy_nt(dest, src, n);
     }
-    return dest;
+    return memcpy_large(dest, src, n);
 }
 
 void *memset(void *s, int c, size_t n)
 {
-    unsigned char *s_ = s;
-    for (size_t i = 0; i < n; i++)
+    if (n < MEMFUNC_REP_THRESHOLD)
     {
-        *s_++ = c;
+        return memset_small(s, c, n);
     }
-    return s;
+    if (use_nt && n >= MEMFUNC_NT_THRESHOLD)
+    {
+        return memset_nt(s, c, n);
+    }
+    return memset_large(s, c, n);
 }
 
-caddr_t sbrk(int incr)
+void *memmove(void *dest, const void *src, size_t n)
 {
-    return 0;
+    return memmove_sse2(dest, src, n);
+}
+
+int memcmp(const void *s1, const void *s2, size_t n)
+{
+    return memcmp_sse2(s1, s2, n);
+}
+
+size_t strlen(const char *s)
+{
+    return strlen_sse2(s);
 }
 
 int close(int file)
@@ -0,0 +1,387 @@
+/** @file memfunc.c implements memcpy/memset variants and SSE2 versions of
+ * memmove, memcmp and strlen.
+ *
+ * This file must not depend on the kernel, so that test/ can build it
+ * for the host. Build it with -ffreestanding, or the compiler may turn
+ * the loops below into calls to memcpy/memset.
+ */
+
+#include "memfunc.h"
+
+#include <stdint.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+typedef uint64_t __attribute__((aligned(1), may_alias)) unaligned_u64;
+typedef uint32_t __attribute__((aligned(1), may_alias)) unaligned_u32;
+typedef uint16_t __attribute__((aligned(1), may_alias)) unaligned_u16;
+
+#define AVX2 __attribute__((target("avx2")))
+
+/* copies n < 16 bytes with at most two overlapping loads and stores */
+static void copy_small(unsigned char *d, const unsigned char *s, size_t n)
+{
+    if (n >= 8)
+    {
+        uint64_t head = *(const unaligned_u64 *)s;
+        uint64_t tail = *(const unaligned_u64 *)(s + n - 8);
+        *(unaligned_u64 *)d = head;
+        *(unaligned_u64 *)(d + n - 8) = tail;
+    }
+    else if (n >= 4)
+    {
+        uint32_t head = *(const unaligned_u32 *)s;
+        uint32_t tail = *(const unaligned_u32 *)(s + n - 4);
+        *(unaligned_u32 *)d = head;
+        *(unaligned_u32 *)(d + n - 4) = tail;
+    }
+    else if (n >= 2)
+    {
+        uint16_t head = *(const unaligned_u16 *)s;
+        uint16_t tail = *(const unaligned_u16 *)(s + n - 2);
+        *(unaligned_u16 *)d = head;
+        *(unaligned_u16 *)(d + n - 2) = tail;
+    }
+    else if (n == 1)
+    {
+        *d = *s;
+    }
+}
+
+static void set_small(unsigned char *d, unsigned char c, size_t n)
+{
+    uint64_t v = 0x0101010101010101u * c;
+    if (n >= 8)
+    {
+        *(unaligned_u64 *)d = v;
+        *(unaligned_u64 *)(d + n - 8) = v;
+    }
+    else if (n >= 4)
+    {
+        *(unaligned_u32 *)d = (uint32_t)v;
+        *(unaligned_u32 *)(d + n - 4) = (uint32_t)v;
+    }
+    else if (n >= 2)
+    {
+        *(unaligned_u16 *)d = (uint16_t)v;
+        *(unaligned_u16 *)(d + n - 2) = (uint16_t)v;
+    }
+    else if (n == 1)
+    {
+        *d = c;
+    }
+}
+
+void *memcpy_byte(void *dest, const void *src, size_t n)
+{
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    for (size_t i = 0; i < n; i++)
+    {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+void *memcpy_erms(void *dest, const void *src, size_t n)
+{
+    void *d = dest;
+    __asm__ volatile("rep movsb"
+                     : "+D"(d), "+S"(src), "+c"(n)
+                     :
+                     : "memory");
+    return dest;
+}
+
+void *memcpy_sse2(void *dest, const void *src, size_t n)
+{
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    if (n < 16)
+    {
+        copy_small(d, s, n);
+        return dest;
+    }
+
+    /* the last 16 bytes are stored at the end, overlapping the loop */
+    const __m128i tail = _mm_loadu_si128((const __m128i *)(s + n - 16));
+    size_t i = 0;
+    for (; i + 64 < n; i += 64)
+    {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(s + i + 16));
+        __m128i x2 = _mm_loadu_si128((const __m128i *)(s + i + 32));
+        __m128i x3 = _mm_loadu_si128((const __m128i *)(s + i + 48));
+        _mm_storeu_si128((__m128i *)(d + i), x0);
+        _mm_storeu_si128((__m128i *)(d + i + 16), x1);
+        _mm_storeu_si128((__m128i *)(d + i + 32), x2);
+        _mm_storeu_si128((__m128i *)(d + i + 48), x3);
+    }
+    for (; i + 16 < n; i += 16)
+    {
+        _mm_storeu_si128((__m128i *)(d + i),
+                         _mm_loadu_si128((const __m128i *)(s + i)));
+    }
+    _mm_storeu_si128((__m128i *)(d + n - 16), tail);
+    return dest;
+}
+
+AVX2 void *memcpy_avx2(void *dest, const void *src, size_t n)
+{
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    if (n < 32)
+    {
+        return memcpy_sse2(dest, src, n);
+    }
+
+    const __m256i tail = _mm256_loadu_si256((const __m256i *)(s + n - 32));
+    size_t i = 0;
+    for (; i + 128 < n; i += 128)
+    {
+        __m256i y0 = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i y1 = _mm256_loadu_si256((const __m256i *)(s + i + 32));
+        __m256i y2 = _mm256_loadu_si256((const __m256i *)(s + i + 64));
+        __m256i y3 = _mm256_loadu_si256((const __m256i *)(s + i + 96));
+        _mm256_storeu_si256((__m256i *)(d + i), y0);
+        _mm256_storeu_si256((__m256i *)(d + i + 32), y1);
+        _mm256_storeu_si256((__m256i *)(d + i + 64), y2);
+        _mm256_storeu_si256((__m256i *)(d + i + 96), y3);
+    }
+    for (; i + 32 < n; i += 32)
+    {
+        _mm256_storeu_si256((__m256i *)(d + i),
+                            _mm256_loadu_si256((const __m256i *)(s + i)));
+    }
+    _mm256_storeu_si256((__m256i *)(d + n - 32), tail);
+    return dest;
+}
+
+void *memcpy_nt(void *dest, const void *src, size_t n)
+{
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    if (n < 64)
+    {
+        return memcpy_sse2(dest, src, n);
+    }
+
+    /* store the unaligned head normally, then stream from a 16-byte
+     * aligned destination */
+    const __m128i tail = _mm_loadu_si128((const __m128i *)(s + n - 16));
+    _mm_storeu_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+    size_t i = 16 - ((uintptr_t)d & 15);
+    for (; i + 64 < n; i += 64)
+    {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(s + i + 16));
+        __m128i x2 = _mm_loadu_si128((const __m128i *)(s + i + 32));
+        __m128i x3 = _mm_loadu_si128((const __m128i *)(s + i + 48));
+        _mm_stream_si128((__m128i *)(d + i), x0);
+        _mm_stream_si128((__m128i *)(d + i + 16), x1);
+        _mm_stream_si128((__m128i *)(d + i + 32), x2);
+        _mm_stream_si128((__m128i *)(d + i + 48), x3);
+    }
+    for (; i + 16 < n; i += 16)
+    {
+        _mm_stream_si128((__m128i *)(d + i),
+                         _mm_loadu_si128((const __m128i *)(s + i)));
+    }
+    _mm_sfence();
+    _mm_storeu_si128((__m128i *)(d + n - 16), tail);
+    return dest;
+}
+
+void *memset_byte(void *s, int c, size_t n)
+{
+    unsigned char *s_ = s;
+    for (size_t i = 0; i < n; i++)
+    {
+        *s_++ = c;
+    }
+    return s;
+}
+
+void *memset_erms(void *s, int c, size_t n)
+{
+    void *d = s;
+    __asm__ volatile("rep stosb"
+                     : "+D"(d), "+c"(n)
+                     : "a"(c)
+                     : "memory");
+    return s;
+}
+
+void *memset_sse2(void *s, int c, size_t n)
+{
+    unsigned char *d = s;
+    if (n < 16)
+    {
+        set_small(d, c, n);
+        return s;
+    }
+
+    const __m128i v = _mm_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 64 < n; i += 64)
+    {
+        _mm_storeu_si128((__m128i *)(d + i), v);
+        _mm_storeu_si128((__m128i *)(d + i + 16), v);
+        _mm_storeu_si128((__m128i *)(d + i + 32), v);
+        _mm_storeu_si128((__m128i *)(d + i + 48), v);
+    }
+    for (; i + 16 < n; i += 16)
+    {
+        _mm_storeu_si128((__m128i *)(d + i), v);
+    }
+    _mm_storeu_si128((__m128i *)(d + n - 16), v);
+    return s;
+}
+
+AVX2 void *memset_avx2(void *s, int c, size_t n)
+{
+    unsigned char *d = s;
+    if (n < 32)
+    {
+        return memset_sse2(s, c, n);
+    }
+
+    const __m256i v = _mm256_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 128 < n; i += 128)
+    {
+        _mm256_storeu_si256((__m256i *)(d + i), v);
+        _mm256_storeu_si256((__m256i *)(d + i + 32), v);
+        _mm256_storeu_si256((__m256i *)(d + i + 64), v);
+        _mm256_storeu_si256((__m256i *)(d + i + 96), v);
+    }
+    for (; i + 32 < n; i += 32)
+    {
+        _mm256_storeu_si256((__m256i *)(d + i), v);
+    }
+    _mm256_storeu_si256((__m256i *)(d + n - 32), v);
+    return s;
+}
+
+void *memset_nt(void *s, int c, size_t n)
+{
+    unsigned char *d = s;
+    if (n < 64)
+    {
+        return memset_sse2(s, c, n);
+    }
+
+    const __m128i v = _mm_set1_epi8((char)c);
+    _mm_storeu_si128((__m128i *)d, v);
+    size_t i = 16 - ((uintptr_t)d & 15);
+    for (; i + 64 < n; i += 64)
+    {
+        _mm_stream_si128((__m128i *)(d + i), v);
+        _mm_stream_si128((__m128i *)(d + i + 16), v);
+        _mm_stream_si128((__m128i *)(d + i + 32), v);
+        _mm_stream_si128((__m128i *)(d + i + 48), v);
+    }
+    for (; i + 16 < n; i += 16)
+    {
+        _mm_stream_si128((__m128i *)(d + i), v);
+    }
+    _mm_sfence();
+    _mm_storeu_si128((__m128i *)(d + n - 16), v);
+    return s;
+}
+
+void *memmove_sse2(void *dest, const void *src, size_t n)
+{
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+    if (d == s || n == 0)
+    {
+        return dest;
+    }
+    if (d + n <= s || s + n <= d)
+    {
+        return memcpy_sse2(dest, src, n);
+    }
+
+    /* each chunk is loaded before it is stored, so copying away from
+     * the overlapping side never reads overwritten bytes */
+    size_t i;
+    if (d < s)
+    {
+        for (i = 0; i + 16 <= n; i += 16)
+        {
+            _mm_storeu_si128((__m128i *)(d + i),
+                             _mm_loadu_si128((const __m128i *)(s + i)));
+        }
+        for (; i < n; i++)
+        {
+            d[i] = s[i];
+        }
+    }
+    else
+    {
+        for (i = n; i >= 16; i -= 16)
+        {
+            _mm_storeu_si128((__m128i *)(d + i - 16),
+                             _mm_loadu_si128((const __m128i *)(s + i - 16)));
+        }
+        while (i > 0)
+        {
+            --i;
+            d[i] = s[i];
+        }
+    }
+    return dest;
+}
+
+int memcmp_sse2(const void *s1, const void *s2, size_t n)
+{
+    const unsigned char *a = s1;
+    const unsigned char *b = s2;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        const unsigned int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (eq != 0xffffu)
+        {
+            const int j = __builtin_ctz(~eq);
+            return a[i + j] - b[i + j];
+        }
+    }
+    for (; i < n; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return a[i] - b[i];
+        }
+    }
+    return 0;
+}
+
+size_t strlen_sse2(const char *s)
+{
+    /* aligned loads never cross a page boundary, so reading
+     * the bytes around the string is safe */
+    const __m128i zero = _mm_setzero_si128();
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    unsigned int mask = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_load_si128((const __m128i *)p), zero));
+    mask >>= s - p;
+    if (mask)
+    {
+        return __builtin_ctz(mask);
+    }
+
+    for (;;)
+    {
+        p += 16;
+        mask = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_load_si128((const __m128i *)p), zero));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask) - s;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef LIBC_MEMFUNC_H_
+#define LIBC_MEMFUNC_H_
+
+/** @file memfunc.h declares the implementations behind memcpy and friends.
+ *
+ * libc/func.c picks one of the memcpy/memset variants at boot
+ * by memfunc_init().
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *MemcpyFunc(void *dest, const void *src, size_t n);
+typedef void *MemsetFunc(void *s, int c, size_t n);
+
+void *memcpy_byte(void *dest, const void *src, size_t n);
+void *memcpy_erms(void *dest, const void *src, size_t n);
+void *memcpy_sse2(void *dest, const void *src, size_t n);
+void *memcpy_avx2(void *dest, const void *src, size_t n);
+/* non-temporal stores, for large destinations such as the frame buffer */
+void *memcpy_nt(void *dest, const void *src, size_t n);
+
+void *memset_byte(void *s, int c, size_t n);
+void *memset_erms(void *s, int c, size_t n);
+void *memset_sse2(void *s, int c, size_t n);
+void *memset_avx2(void *s, int c, size_t n);
+void *memset_nt(void *s, int c, size_t n);
+
+void *memmove_sse2(void *dest, const void *src, size_t n);
+int memcmp_sse2(const void *s1, const void *s2, size_t n);
+size_t strlen_sse2(const char *s);
+
+/* sizes from which memcpy/memset switch to rep movsb/stosb
+ * and to non-temporal stores */
+#define MEMFUNC_REP_THRESHOLD 2048
+#define MEMFUNC_NT_THRESHOLD (1024 * 1024)
+
+/** @brief memfunc_init selects memcpy/memset variants from CPUID.
+ *
+ * AVX state is enabled in CR4/XCR0 if the CPU supports AVX2.
+ * Call this once before any other code, in kernel only.
+ */
+void memfunc_init(void);
+
+/** @brief memfunc_variant returns the name of the selected variant. */
+const char *memfunc_variant(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBC_MEMFUNC_H_ */
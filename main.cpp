@@ -11,15 +11,25 @@ int errno;
 
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "asmfunc.h"
+#include "libc/memfunc.h"
 #include "bootparam.h"
 #include "memory.hpp"
+#include "slab.hpp"
+#include "heap.hpp"
+#include "paging.hpp"
 #include "graphics.hpp"
+#include "vbe.hpp"
 #include "debug_console.hpp"
+#include "debug_shell.hpp"
+#include "acpi.hpp"
+#include "apic.hpp"
 #include "desctable.hpp"
+#include "interrupt.hpp"
 #include "queue.hpp"
-#include "mutex.hpp"
+#include "timer.hpp"
 
 using namespace bitnos;
 
@@ -40,10 +50,7 @@ extern "C" int write(int file, char *ptr, int len)
         return -1;
     }
 
-    for (int i = 0; i < len; i++)
-    {
-        default_debug_console->PutChar(*ptr++);
-    }
+    default_debug_console->Write(ptr, len);
     return len;
 }
 
@@ -157,23 +164,74 @@ void init_keyboard()
     IoOut8(PORT_KEYDAT, KBC_MODE);
 }
 
-ArrayQueue<uint8_t, 16> keydat;
-SpinLockMutex keydat_mutex;
-volatile unsigned int num_lostkey = 0;
+// filled by OnKeyboard, drained by the main loop
+SpscQueue<uint8_t, 256> keydat;
+volatile unsigned int num_keydat_full = 0; // keys dropped on a full queue
+
+bool use_apic = false;
 
-extern "C" void Inthandler21(void)
+void OnKeyboard(interrupt::InterruptFrame& frame)
 {
-    IoOut8(PIC0_OCW2, 0x61);	/* IRQ-01受付完了をPICに通知 */
+    if (use_apic)
+    {
+        apic::EndOfInterrupt();
+    }
+    else
+    {
+        IoOut8(PIC0_OCW2, 0x61);	/* IRQ-01受付完了をPICに通知 */
+    }
     auto dat = IoIn8(PORT_KEYDAT);
 
-    if (keydat_mutex.TryLock())
+    if (IsError(keydat.Push(dat)))
     {
-        keydat.Push(dat);
-        keydat_mutex.Unlock();
+        ++num_keydat_full;
     }
-    else
+}
+
+graphics::Compositor *compositor = nullptr;
+
+void OnException(interrupt::InterruptFrame& frame)
+{
+    printf("exception %lu (error %lx) at %04lx:%016lx rsp %016lx\n",
+        frame.vector, frame.error_code, frame.cs, frame.rip, frame.rsp);
+    fflush(stdout);
+    if (default_debug_console)
+    {
+        default_debug_console->Render();
+    }
+    if (compositor)
     {
-        ++num_lostkey;
+        compositor->Compose();
+    }
+    for (;;)
+    {
+        __asm__("cli\n\thlt");
+    }
+}
+
+bool KeyArrived()
+{
+    return keydat.Count() != 0;
+}
+
+/** DrawStatusBar redraws the status bar if its text has changed. */
+void DrawStatusBar(graphics::Layer& bar)
+{
+    static char last_text[64];
+    char text[64];
+    snprintf(text, sizeof(text), " free %lu MiB  dropped keys %u",
+        memory::frame_allocator->NumFreeFrames() * memory::kBytesPerFrame >> 20,
+        num_keydat_full);
+    if (strcmp(text, last_text) == 0)
+    {
+        return;
+    }
+    strcpy(last_text, text);
+
+    bar.FillRect({0, 0}, bar.Resolution(), {64, 64, 64, 0});
+    for (int i = 0; text[i]; ++i)
+    {
+        graphics::DrawAscii(bar, {8 * i, 0}, text[i], {255, 255, 255, 0});
     }
 }
 
@@ -203,50 +261,131 @@ BootParam* kernel_boot_param;
 
 extern "C" unsigned long MyMain(struct BootParam *param)
 {
+    memfunc_init();
     kernel_boot_param = param;
+    memory::InitializeFrameAllocator(*param);
+    if (!IsError(paging::InitializePaging(*param)))
+    {
+        memory::ReclaimBootServicesMemory(*param);
+    }
+    memory::InitializeSlab();
+    if (!IsError(memory::InitializeHeap()))
+    {
+        // flushed explicitly by the shell and before the CPU halts
+        setvbuf(stdout, nullptr, _IOFBF, BUFSIZ);
+    }
 
     struct GraphicMode *mode = param->graphic_mode;
+
+    // a Bochs display scrolls by moving its window over a taller frame buffer
+    auto vbe_display = vbe::Initialize(*mode);
+    struct GraphicMode writer_mode = *mode;
+    if (!IsError(vbe_display.error))
+    {
+        writer_mode.vertical_resolution = vbe_display.value->VirtualHeight();
+    }
+
     graphics::PixelWriter *writer = nullptr;
     uint8_t writer_buf[256];
     switch (mode->pixel_format) {
     case kPixelRedGreenBlueReserved8BitPerColor:
-        writer = new(writer_buf) graphics::PixelWriterRedGreenBlueReserved8BitPerColor(mode);
+        writer = new(writer_buf) graphics::PixelWriterRedGreenBlueReserved8BitPerColor(&writer_mode);
         break;
     case kPixelBlueGreenRedReserved8BitPerColor:
-        writer = new(writer_buf) graphics::PixelWriterBlueGreenRedReserved8BitPerColor(mode);
+        writer = new(writer_buf) graphics::PixelWriterBlueGreenRedReserved8BitPerColor(&writer_mode);
+        break;
+    case kPixelBitMask:
+        writer = new(writer_buf) graphics::PixelWriterBitMask(
+            &writer_mode, graphics::BitMaskFormat(mode->pixel_information));
         break;
-    defualt:
+    default: // kPixelBltOnly has no frame buffer to draw to
         break;
     }
 
     if (writer == nullptr) {
         return 0;
     }
+
+    // without one, compose a console layer and a status bar in RAM and
+    // copy only the changed areas to the frame buffer
+    graphics::PixelWriter *screen = writer;
+    graphics::Layer *status_bar = nullptr;
+    unsigned int console_height = mode->vertical_resolution;
+    if (IsError(vbe_display.error))
+    {
+        const auto resolution = writer->Resolution();
+        compositor = new graphics::Compositor(*writer, {255, 255, 255, 0});
+        auto console_layer = compositor->NewLayer({resolution.width, resolution.height - 16});
+        if (console_layer)
+        {
+            compositor->SetVisible(*console_layer, true);
+            screen = console_layer;
+            console_height -= 16;
+
+            status_bar = compositor->NewLayer({resolution.width, 16});
+            if (status_bar)
+            {
+                compositor->MoveLayer(*status_bar, {0, static_cast<int>(console_height)});
+                compositor->SetVisible(*status_bar, true);
+            }
+        }
+        else
+        {
+            delete compositor;
+            compositor = nullptr;
+        }
+    }
+
     DebugConsole cons(
-        *writer,
-        {mode->horizontal_resolution / 8, mode->vertical_resolution / 16}
+        *screen,
+        {mode->horizontal_resolution / 8, console_height / 16}
         );
     default_debug_console = &cons;
+    if (!IsError(vbe_display.error))
+    {
+        cons.UseDisplay(*vbe_display.value);
+    }
 
-    for (int y = 0; y < mode->vertical_resolution; y++) {
-        for (int x = 0; x < mode->horizontal_resolution; x++) {
-            writer->Write({x, y}, {255, 255, 255, 0});
-        }
+    screen->FillRect({0, 0}, screen->Resolution(), {255, 255, 255, 0});
+
+    interrupt::Initialize();
+    for (uint8_t vector = 0; vector < 32; ++vector)
+    {
+        interrupt::SetHandler(vector, OnException, true);
     }
+    interrupt::SetHandler(0x21, OnKeyboard, false);
 
-    auto idtr = GetIDTR();
-    auto err = SetIDTEntry(
-        idtr,
-        0x21,
-        reinterpret_cast<uint64_t>(AsmInthandler21),
-        MakeIDTAttr(1, 0, 14, 0),
-        0x38);
+    // the I/O APIC takes over from the 8259 pair if the MADT lists one
+    auto err = acpi::Initialize(*param);
+    if (!IsError(err))
+    {
+        err = apic::Initialize();
+    }
+    if (!IsError(err))
+    {
+        // IRQ1 may fire as soon as it is routed and must EOI the LAPIC
+        use_apic = true;
+        err = apic::RouteIsaIrq(1, 0x21, apic::LapicId());
+        use_apic = !IsError(err);
+    }
+    if (!use_apic)
+    {
+        printf("no APIC (%d), using the 8259\n", err);
+        init_pic();
+    }
 
+    err = timer::InitializeClock();
+    if (!IsError(err) && use_apic)
+    {
+        err = timer::InitializeTimer();
+    }
     if (IsError(err))
     {
-        printf("SetIDTEntry: %d\n", err);
+        printf("no timer (%d)\n", err);
     }
+    init_keyboard();
 
+    // run after the clock is up so that commands can time out
     DebugShell shell(cons);
 
     const char* auto_cmd = "lspci\nlspci 00:04.00\nxhci\n";
@@ -255,24 +394,39 @@ extern "C" unsigned long MyMain(struct BootParam *param)
         shell.PutChar(auto_cmd[i]);
     }
 
-    init_pic();
-    init_keyboard();
-
     bool shifted = false;
     for (;;) {
         {
-            keydat_mutex.Lock();
             if (keydat.Count() == 0)
             {
-                keydat_mutex.Unlock();
-                __asm__("hlt");
+                fflush(stdout);
+                cons.Render();
+                if (compositor)
+                {
+                    if (status_bar)
+                    {
+                        DrawStatusBar(*status_bar);
+                    }
+                    compositor->Compose();
+                }
+                if (memory::FillZeroedFramePool(KeyArrived))
+                {
+                    continue;
+                }
+
+                // a key arriving after the check would wait for the next one
+                __asm__("cli");
+                if (keydat.Count() != 0)
+                {
+                    __asm__("sti");
+                    continue;
+                }
+                __asm__("sti\n\thlt"); // no interrupt can slip in between
                 continue;
             }
 
             auto key = keydat.Front();
             keydat.Pop();
-            keydat_mutex.Unlock();
-            //printf("%2x (lost keys %u)\n", key, num_lostkey);
             if (key < 0x80)
             {
                 // press
@@ -1,5 +1,11 @@
 #include "memory.hpp"
 
+#include <string.h>
+
+#include "desctable.hpp"
+#include "heapprof.hpp"
+#include "libc/memfunc.h"
+#include "slab.hpp"
 
 void* operator new(size_t size, void* buf)
 {
@@ -8,7 +14,22 @@ void* operator new(size_t size, void* buf)
 
 void* operator new(size_t size)
 {
-    return nullptr;
+    auto obj = bitnos::memory::AllocateObject(size);
+    if (bitnos::heapprof::kEnabled)
+    {
+        bitnos::heapprof::RecordAllocation(obj, size, __builtin_return_address(0));
+    }
+    return obj;
+}
+
+void* operator new[](size_t size)
+{
+    auto obj = bitnos::memory::AllocateObject(size);
+    if (bitnos::heapprof::kEnabled)
+    {
+        bitnos::heapprof::RecordAllocation(obj, size, __builtin_return_address(0));
+    }
+    return obj;
 }
 
 void operator delete(void* obj, void* buf) noexcept
@@ -17,4 +38,198 @@ void operator delete(void* obj, void* buf) noexcept
 
 void operator delete(void* obj) noexcept
 {
+    if (bitnos::heapprof::kEnabled)
+    {
+        bitnos::heapprof::RecordFree(obj);
+    }
+    bitnos::memory::FreeObject(obj);
+}
+
+void operator delete[](void* obj) noexcept
+{
+    if (bitnos::heapprof::kEnabled)
+    {
+        bitnos::heapprof::RecordFree(obj);
+    }
+    bitnos::memory::FreeObject(obj);
+}
+
+namespace
+{
+    using namespace bitnos::memory;
+
+    // Frames below 1 MiB are left to legacy firmware structures.
+    const uintptr_t kLowMemoryEnd = 0x100000;
+
+    char frame_allocator_buf[sizeof(FrameAllocator)]
+        __attribute__((aligned(alignof(FrameAllocator))));
+
+    // zeroed frames are chained through their first word
+    struct ZeroedFrame
+    {
+        ZeroedFrame* next;
+    };
+
+    ZeroedFrame* zeroed_frames = nullptr;
+    ZeroedFramePoolStat zeroed_frame_pool_stat;
+
+    // gives the whole pool back when frame_allocator runs out
+    size_t DrainZeroedFramePool()
+    {
+        size_t num_frames = 0;
+        while (zeroed_frames != nullptr)
+        {
+            auto frame = zeroed_frames;
+            zeroed_frames = frame->next;
+            frame_allocator->Free(reinterpret_cast<uintptr_t>(frame), kOrder4KiB);
+            ++num_frames;
+        }
+        zeroed_frame_pool_stat.num_frames = 0;
+        return num_frames;
+    }
+
+    template <typename F>
+    void ForEachDescriptor(const BootParam& param, F f)
+    {
+        const auto base = reinterpret_cast<uintptr_t>(param.memory_map);
+        for (size_t it = 0;
+             it < param.memory_map_size;
+             it += param.memory_descriptor_size)
+        {
+            f(*reinterpret_cast<const EFI_MEMORY_DESCRIPTOR*>(base + it));
+        }
+    }
+
+    size_t AddDescriptor(const EFI_MEMORY_DESCRIPTOR& desc)
+    {
+        uintptr_t start = desc.PhysicalStart;
+        uintptr_t end = start + desc.NumberOfPages * kBytesPerFrame;
+        if (start < kLowMemoryEnd)
+        {
+            start = kLowMemoryEnd;
+        }
+        if (end > kMaxPhysicalMemoryBytes)
+        {
+            end = kMaxPhysicalMemoryBytes;
+        }
+        if (start >= end)
+        {
+            return 0;
+        }
+
+        const size_t num_frames = (end - start) / kBytesPerFrame;
+        frame_allocator->AddRange(start, num_frames);
+        return num_frames;
+    }
+}
+
+namespace bitnos::memory
+{
+    FrameAllocator* frame_allocator = nullptr;
+
+    void InitializeFrameAllocator(const BootParam& param)
+    {
+        frame_allocator = new(frame_allocator_buf) FrameAllocator;
+        frame_allocator->SetReclaimer(DrainZeroedFramePool);
+
+        ForEachDescriptor(param, [](const EFI_MEMORY_DESCRIPTOR& desc)
+            {
+                if (desc.Type == EfiConventionalMemory)
+                {
+                    AddDescriptor(desc);
+                }
+            });
+    }
+
+    size_t ReclaimBootServicesMemory(const BootParam& param)
+    {
+        if (param.efi_system_table->BootServices != nullptr)
+        {
+            // boot services are still alive
+            return 0;
+        }
+
+        // the stack, GDT and IDT set up by the firmware are still in use
+        uintptr_t rsp;
+        __asm__("movq %%rsp, %0" : "=r"(rsp));
+        const uintptr_t in_use[] = {rsp, GetGDTR().base, GetIDTR().base};
+
+        size_t num_frames = 0;
+        ForEachDescriptor(param, [&](const EFI_MEMORY_DESCRIPTOR& desc)
+            {
+                if (desc.Type != EfiBootServicesCode
+                        && desc.Type != EfiBootServicesData)
+                {
+                    return;
+                }
+
+                const uintptr_t start = desc.PhysicalStart;
+                const uintptr_t end =
+                    start + desc.NumberOfPages * kBytesPerFrame;
+                for (auto addr : in_use)
+                {
+                    if (start <= addr && addr < end)
+                    {
+                        return;
+                    }
+                }
+                num_frames += AddDescriptor(desc);
+            });
+        return num_frames;
+    }
+
+    WithError<uintptr_t> AllocateZeroedFrame()
+    {
+        if (zeroed_frames != nullptr)
+        {
+            auto frame = zeroed_frames;
+            zeroed_frames = frame->next;
+            frame->next = nullptr;
+            --zeroed_frame_pool_stat.num_frames;
+            ++zeroed_frame_pool_stat.num_hits;
+            return {reinterpret_cast<uintptr_t>(frame), errorcode::kSuccess};
+        }
+
+        ++zeroed_frame_pool_stat.num_misses;
+        auto frame = frame_allocator->Allocate(kOrder4KiB);
+        if (!IsError(frame.error))
+        {
+            memset(reinterpret_cast<void*>(frame.value), 0, kBytesPerFrame);
+        }
+        return frame;
+    }
+
+    bool FillZeroedFramePool(bool (*has_work)())
+    {
+        while (zeroed_frame_pool_stat.num_frames < kZeroedFramePoolTarget)
+        {
+            if (has_work())
+            {
+                return true;
+            }
+
+            // an empty allocator would take the pool back to serve this
+            if (frame_allocator->NumFreeFrames() == 0)
+            {
+                return false;
+            }
+            auto frame = frame_allocator->Allocate(kOrder4KiB);
+            if (IsError(frame.error))
+            {
+                return false;
+            }
+
+            auto p = reinterpret_cast<ZeroedFrame*>(frame.value);
+            memset_nt(p, 0, kBytesPerFrame);
+            p->next = zeroed_frames;
+            zeroed_frames = p;
+            ++zeroed_frame_pool_stat.num_frames;
+        }
+        return false;
+    }
+
+    ZeroedFramePoolStat GetZeroedFramePoolStat()
+    {
+        return zeroed_frame_pool_stat;
+    }
 }
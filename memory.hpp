@@ -1,16 +1,182 @@
 #ifndef MEMORY_HPP_
 #define MEMORY_HPP_
 
+/** @file memory.hpp provides the physical memory manager of the kernel.
+ */
+
 #include <stddef.h>
+#include <stdint.h>
+
+#include "bootparam.h"
+#include "errorcode.hpp"
 
 void* operator new(size_t size, void* buf);
 void* operator new(size_t size);
+void* operator new[](size_t size);
 void operator delete(void* obj, void* buf) noexcept;
 void operator delete(void* obj) noexcept;
+void operator delete[](void* obj) noexcept;
 
-namespace bitnos
+namespace bitnos::memory
 {
+    const size_t kBytesPerFrame = 4096;
+
+    /*
+     * A block of order k consists of 2^k contiguous frames
+     * and is aligned to its own size.
+     */
+    const unsigned int kOrder4KiB = 0;
+    const unsigned int kOrder2MiB = 9;
+    const unsigned int kOrder1GiB = 18;
+    const unsigned int kMaxOrder = kOrder1GiB;
+
+    const uint64_t kMaxPhysicalMemoryBytes = 64ull * 1024 * 1024 * 1024;
+    const size_t kMaxFrames = kMaxPhysicalMemoryBytes / kBytesPerFrame;
+
+    /** @brief FrameAllocator is a buddy allocator of physical frames.
+     *
+     * Free blocks are linked into one list per order. The list nodes are
+     * embedded in the free frames themselves, so the frames must be mapped
+     * (identity mapping is assumed).
+     * A bitmap records which frames are heads of free blocks, which makes
+     * finding a free buddy O(1) and allocation/free O(log n).
+     */
+    class FrameAllocator
+    {
+        struct FreeBlock
+        {
+            FreeBlock* next;
+            FreeBlock* prev;
+            unsigned int order;
+        };
+
+        using MapLineType = uint64_t;
+        static const size_t kBitsPerMapLine = 8 * sizeof(MapLineType);
+
+        MapLineType free_head_map_[kMaxFrames / kBitsPerMapLine];
+        FreeBlock* free_lists_[kMaxOrder + 1];
+        size_t num_free_blocks_[kMaxOrder + 1];
+        size_t num_free_frames_;
+        size_t num_total_frames_;
+        size_t (*reclaim_)();
+
+        bool IsFreeHead(size_t frame) const;
+        void SetFreeHead(size_t frame, bool head);
+        FreeBlock* BlockAt(size_t frame) const;
+
+        void Link(size_t frame, unsigned int order);
+        void Unlink(size_t frame, unsigned int order);
+
+        unsigned int FindFreeOrder(unsigned int order) const;
+        void FreeBlockAt(size_t frame, unsigned int order);
+        void FreeRange(size_t frame, size_t num_frames);
+
+    public:
+        FrameAllocator();
+        FrameAllocator(const FrameAllocator&) = delete;
+        FrameAllocator& operator =(const FrameAllocator&) = delete;
+
+        /** @brief Allocate allocates a block of 2^order frames.
+         *
+         * @param order  Order of the block (0 to kMaxOrder)
+         * @return Physical address of the block, aligned to its size.
+         */
+        WithError<uintptr_t> Allocate(unsigned int order);
+
+        /** @brief Free returns a block obtained by Allocate.
+         *
+         * @param addr  Physical address returned by Allocate
+         * @param order  Order passed to Allocate
+         */
+        Error Free(uintptr_t addr, unsigned int order);
+
+        /** @brief AllocateFrames allocates num_frames contiguous frames.
+         *
+         * The block is aligned to the power of two not less than num_frames.
+         * Frames beyond num_frames are given back immediately.
+         */
+        WithError<uintptr_t> AllocateFrames(size_t num_frames);
+
+        /** @brief FreeFrames returns frames obtained by AllocateFrames.
+         */
+        Error FreeFrames(uintptr_t addr, size_t num_frames);
+
+        /** @brief AddRange hands a range of usable memory to the allocator.
+         *
+         * @param addr  Physical address (must be frame aligned)
+         * @param num_frames  The number of frames in the range
+         */
+        Error AddRange(uintptr_t addr, size_t num_frames);
+
+        /** @brief SetReclaimer sets a function which gives cached frames
+         * back to the allocator.
+         *
+         * Allocate calls it once before failing with kNoEnoughMemory.
+         * It returns the number of frames given back and must not allocate.
+         */
+        void SetReclaimer(size_t (*reclaim)()) { reclaim_ = reclaim; }
+
+        size_t NumFreeFrames() const { return num_free_frames_; }
+        size_t NumTotalFrames() const { return num_total_frames_; }
+        size_t NumFreeBlocks(unsigned int order) const
+        {
+            return num_free_blocks_[order];
+        }
+    };
+
+    extern FrameAllocator* frame_allocator;
+
+    /** @brief InitializeFrameAllocator constructs frame_allocator
+     * and gives it all EfiConventionalMemory ranges in the memory map.
+     */
+    void InitializeFrameAllocator(const BootParam& param);
+
+    /** @brief ReclaimBootServicesMemory gives EfiBootServicesCode/Data ranges
+     * to frame_allocator.
+     *
+     * Call this only after ExitBootServices has been called and the kernel
+     * no longer uses page tables built by the firmware.
+     * Ranges containing the current stack, GDT and IDT are kept.
+     *
+     * @return The number of frames reclaimed.
+     */
+    size_t ReclaimBootServicesMemory(const BootParam& param);
+
+    /*
+     * Pre-zeroed frame pool.
+     *
+     * Frames are zeroed with non-temporal stores while the CPU is idle,
+     * so that allocations needing zeroed memory (page tables and so on)
+     * skip the clearing cost. frame_allocator takes the pool back
+     * when it runs out of memory.
+     */
+    const size_t kZeroedFramePoolTarget = 256;
+
+    struct ZeroedFramePoolStat
+    {
+        size_t num_frames;
+        size_t num_hits;
+        size_t num_misses;
+    };
+
+    /** @brief AllocateZeroedFrame allocates a zero-filled frame.
+     *
+     * A frame is taken from the pre-zeroed pool if available,
+     * otherwise it is allocated and cleared on the spot.
+     * Free it by frame_allocator->Free(addr, kOrder4KiB).
+     */
+    WithError<uintptr_t> AllocateZeroedFrame();
+
+    /** @brief FillZeroedFramePool zeroes free frames into the pool
+     * until it reaches kZeroedFramePoolTarget, no free frame is left
+     * or has_work() returns true.
+     * has_work is checked before every frame.
+     *
+     * @return true if has_work() stopped it.
+     */
+    bool FillZeroedFramePool(bool (*has_work)());
 
+    ZeroedFramePoolStat GetZeroedFramePoolStat();
 }
 
 #endif // MEMORY_HPP_
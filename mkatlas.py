@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""mkatlas.py writes the full-width glyph atlas (fullwidth.bin) to stdout.
+
+usage: mkatlas.py [unifont.hex]
+
+Glyphs are taken from a GNU Unifont .hex file. Only 16x16 glyphs in the
+full-width ranges of graphics::IsFullWidth are kept. Without a file the
+atlas is empty and the console draws full-width characters as boxes.
+
+Format (little endian):
+  uint32 num_glyphs
+  uint32 code_points[num_glyphs]   ascending
+  uint8  bitmaps[num_glyphs][32]   16 rows of 2 bytes, MSB is the left pixel
+"""
+
+import struct
+import sys
+
+# keep in sync with graphics::IsFullWidth
+FULL_WIDTH_RANGES = [
+    (0x1100, 0x115f),
+    (0x2e80, 0x303e),
+    (0x3041, 0x33ff),
+    (0x3400, 0x4dbf),
+    (0x4e00, 0x9fff),
+    (0xa000, 0xa4cf),
+    (0xac00, 0xd7a3),
+    (0xf900, 0xfaff),
+    (0xfe30, 0xfe4f),
+    (0xff00, 0xff60),
+    (0xffe0, 0xffe6),
+]
+
+
+def is_full_width(code):
+    return any(lo <= code <= hi for lo, hi in FULL_WIDTH_RANGES)
+
+
+def read_glyphs(path):
+    glyphs = {}
+    with open(path) as f:
+        for line in f:
+            code, sep, bitmap = line.strip().partition(':')
+            if not sep or len(bitmap) != 64:
+                continue
+            code = int(code, 16)
+            if is_full_width(code):
+                glyphs[code] = bytes.fromhex(bitmap)
+    return glyphs
+
+
+def main():
+    if len(sys.argv) > 1:
+        glyphs = read_glyphs(sys.argv[1])
+    else:
+        glyphs = {}
+        print('mkatlas.py: warning: no font given, full-width characters '
+              'will be drawn as boxes (make FONT_HEX=unifont.hex)',
+              file=sys.stderr)
+    codes = sorted(glyphs)
+    out = sys.stdout.buffer
+    out.write(struct.pack('<I', len(codes)))
+    out.write(struct.pack('<%dI' % len(codes), *codes))
+    for code in codes:
+        out.write(glyphs[code])
+
+
+if __name__ == '__main__':
+    main()
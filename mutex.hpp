@@ -1,14 +1,144 @@
 #ifndef MUTEX_HPP_
 #define MUTEX_HPP_
 
+/** @file mutex.hpp provides spin locks.
+ *
+ * Waiters spin on plain loads with pause and back off, so a contended
+ * line isn't hammered with locked operations. Unlock is a release store.
+ * Contention statistics are compiled in when LOCK_STATS is defined
+ * (make LOCK_STATS=1).
+ */
+
 #include <stdint.h>
 #include "asmfunc.h"
 
 namespace bitnos
 {
+#ifdef LOCK_STATS
+    const bool kLockStatsEnabled = true;
+#else
+    const bool kLockStatsEnabled = false;
+#endif
+
+    /** @brief CpuRelax tells the CPU it is in a spin-wait loop.
+     */
+    inline void CpuRelax()
+    {
+        __asm__ volatile("pause" : : : "memory");
+    }
+
+    /** @brief SaveAndDisableInterrupts clears IF and returns RFLAGS
+     * before that.
+     */
+    inline uint64_t SaveAndDisableInterrupts()
+    {
+        uint64_t flags;
+        __asm__ volatile("pushfq\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+        return flags;
+    }
+
+    /** @brief RestoreInterrupts sets IF again if it was set in flags.
+     */
+    inline void RestoreInterrupts(uint64_t flags)
+    {
+        if (flags & (1u << 9))
+        {
+            __asm__ volatile("sti" : : : "memory");
+        }
+    }
+
+    /** @brief Backoff pauses twice as long on each call, up to kMaxPauses.
+     */
+    class Backoff
+    {
+        unsigned int pauses_;
+
+    public:
+        const static unsigned int kMaxPauses = 1024;
+
+        Backoff()
+            : pauses_(1)
+        {}
+
+        /** @return The number of pauses spent. */
+        unsigned int Pause()
+        {
+            const auto pauses = pauses_;
+            for (unsigned int i = 0; i < pauses; ++i)
+            {
+                CpuRelax();
+            }
+            if (pauses_ < kMaxPauses)
+            {
+                pauses_ *= 2;
+            }
+            return pauses;
+        }
+    };
+
+    struct LockStats
+    {
+        uint64_t acquisitions;
+        uint64_t contended; // acquisitions that had to wait
+        uint64_t spins;     // pauses spent waiting
+        uint64_t max_hold_cycles;
+    };
+
+    /** @brief LockStatsRecorder is updated by the lock holder only,
+     * so it needs no atomics. Without LOCK_STATS it does nothing.
+     */
+    class LockStatsRecorder
+    {
+        LockStats stats_;
+        uint64_t acquired_at_;
+
+    public:
+        LockStatsRecorder()
+            : stats_{}, acquired_at_(0)
+        {}
+
+        void OnAcquire(uint64_t spins)
+        {
+            if (kLockStatsEnabled)
+            {
+                ++stats_.acquisitions;
+                stats_.contended += spins != 0;
+                stats_.spins += spins;
+                acquired_at_ = ReadTSC();
+            }
+        }
+
+        void OnRelease()
+        {
+            if (kLockStatsEnabled)
+            {
+                const auto held = ReadTSC() - acquired_at_;
+                if (held > stats_.max_hold_cycles)
+                {
+                    stats_.max_hold_cycles = held;
+                }
+            }
+        }
+
+        /** @brief Stats is exact only while no one else uses the lock. */
+        const LockStats& Stats() const
+        {
+            return stats_;
+        }
+
+        void Reset()
+        {
+            stats_ = LockStats{};
+        }
+    };
+
+    /** @brief SpinLockMutex is a test-and-test-and-set lock with
+     * exponential backoff. It is the smallest lock, but not fair.
+     */
     class SpinLockMutex
     {
         uint64_t flag_;
+        LockStatsRecorder stats_;
 
     public:
         const static uint64_t kClear = 0;
@@ -24,22 +154,284 @@ namespace bitnos
 
         void Lock()
         {
-            while (kFlagged == CompareExchange(&flag_, kClear, kFlagged));
+            uint64_t spins = 0;
+            Backoff backoff;
+            while (__atomic_exchange_n(&flag_, kFlagged, __ATOMIC_ACQUIRE) == kFlagged)
+            {
+                while (__atomic_load_n(&flag_, __ATOMIC_RELAXED) == kFlagged)
+                {
+                    spins += backoff.Pause();
+                }
+            }
+            stats_.OnAcquire(spins);
         }
 
         bool TryLock()
         {
-            return kClear == CompareExchange(&flag_, kClear, kFlagged);
+            if (__atomic_load_n(&flag_, __ATOMIC_RELAXED) == kFlagged ||
+                __atomic_exchange_n(&flag_, kFlagged, __ATOMIC_ACQUIRE) == kFlagged)
+            {
+                return false;
+            }
+            stats_.OnAcquire(0);
+            return true;
         }
 
         void Unlock()
         {
-            LFencedWrite(&flag_, kClear);
+            stats_.OnRelease();
+            __atomic_store_n(&flag_, kClear, __ATOMIC_RELEASE);
         }
 
         bool IsLocked() const
         {
-            return flag_ == 1;
+            return __atomic_load_n(&flag_, __ATOMIC_RELAXED) == kFlagged;
+        }
+
+        LockStatsRecorder& Stats()
+        {
+            return stats_;
+        }
+    };
+
+    /** @brief TicketLock grants the lock in arrival order.
+     *
+     * A waiter backs off in proportion to the number of holders ahead of
+     * it rather than exponentially, so it doesn't sleep through its turn.
+     */
+    class TicketLock
+    {
+        uint32_t next_;  // ticket handed to the next arrival
+        uint32_t owner_; // ticket being served
+        LockStatsRecorder stats_;
+
+    public:
+        const static unsigned int kPausesPerWaiter = 32;
+
+        TicketLock()
+            : next_(0), owner_(0)
+        {}
+
+        ~TicketLock() = default;
+        TicketLock(const TicketLock&) = delete;
+        TicketLock& operator =(const TicketLock&) = delete;
+
+        void Lock()
+        {
+            const auto ticket = __atomic_fetch_add(&next_, 1, __ATOMIC_RELAXED);
+            uint64_t spins = 0;
+            for (;;)
+            {
+                const uint32_t ahead = ticket - __atomic_load_n(&owner_, __ATOMIC_ACQUIRE);
+                if (ahead == 0)
+                {
+                    break;
+                }
+                for (unsigned int i = 0; i < ahead * kPausesPerWaiter; ++i)
+                {
+                    CpuRelax();
+                }
+                spins += ahead * kPausesPerWaiter;
+            }
+            stats_.OnAcquire(spins);
+        }
+
+        bool TryLock()
+        {
+            auto ticket = __atomic_load_n(&owner_, __ATOMIC_RELAXED);
+            if (!__atomic_compare_exchange_n(&next_, &ticket, ticket + 1, false,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                return false;
+            }
+            stats_.OnAcquire(0);
+            return true;
+        }
+
+        void Unlock()
+        {
+            stats_.OnRelease();
+            // only the holder writes owner_
+            __atomic_store_n(&owner_, owner_ + 1, __ATOMIC_RELEASE);
+        }
+
+        bool IsLocked() const
+        {
+            return __atomic_load_n(&next_, __ATOMIC_RELAXED) !=
+                __atomic_load_n(&owner_, __ATOMIC_RELAXED);
+        }
+
+        LockStatsRecorder& Stats()
+        {
+            return stats_;
+        }
+    };
+
+    /** @brief McsLock queues waiters in a list of nodes they own.
+     *
+     * Each waiter spins on its own node, so a handover touches one line
+     * of one waiter regardless of how many are waiting. The node must stay
+     * alive from Lock until Unlock; Guard keeps it on the stack.
+     */
+    class McsLock
+    {
+    public:
+        struct Node
+        {
+            Node* next;
+            bool locked;
+        };
+
+        McsLock()
+            : tail_(nullptr)
+        {}
+
+        ~McsLock() = default;
+        McsLock(const McsLock&) = delete;
+        McsLock& operator =(const McsLock&) = delete;
+
+        void Lock(Node& node)
+        {
+            node.next = nullptr;
+            node.locked = true;
+            auto prev = __atomic_exchange_n(&tail_, &node, __ATOMIC_ACQ_REL);
+            uint64_t spins = 0;
+            if (prev)
+            {
+                __atomic_store_n(&prev->next, &node, __ATOMIC_RELEASE);
+                while (__atomic_load_n(&node.locked, __ATOMIC_ACQUIRE))
+                {
+                    CpuRelax();
+                    ++spins;
+                }
+            }
+            stats_.OnAcquire(spins);
+        }
+
+        bool TryLock(Node& node)
+        {
+            node.next = nullptr;
+            node.locked = true;
+            Node* expected = nullptr;
+            if (!__atomic_compare_exchange_n(&tail_, &expected, &node, false,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                return false;
+            }
+            stats_.OnAcquire(0);
+            return true;
+        }
+
+        void Unlock(Node& node)
+        {
+            stats_.OnRelease();
+            auto next = __atomic_load_n(&node.next, __ATOMIC_ACQUIRE);
+            if (next == nullptr)
+            {
+                auto expected = &node;
+                if (__atomic_compare_exchange_n(&tail_, &expected, nullptr, false,
+                                                __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                {
+                    return;
+                }
+                // a successor swapped tail_ but hasn't linked itself yet
+                while ((next = __atomic_load_n(&node.next, __ATOMIC_ACQUIRE)) == nullptr)
+                {
+                    CpuRelax();
+                }
+            }
+            __atomic_store_n(&next->locked, false, __ATOMIC_RELEASE);
+        }
+
+        bool IsLocked() const
+        {
+            return __atomic_load_n(&tail_, __ATOMIC_RELAXED) != nullptr;
+        }
+
+        LockStatsRecorder& Stats()
+        {
+            return stats_;
+        }
+
+        class Guard
+        {
+            McsLock& lock_;
+            Node node_;
+
+        public:
+            Guard(McsLock& lock)
+                : lock_(lock)
+            {
+                lock_.Lock(node_);
+            }
+
+            ~Guard()
+            {
+                lock_.Unlock(node_);
+            }
+
+            Guard(const Guard&) = delete;
+            Guard& operator =(const Guard&) = delete;
+        };
+
+    private:
+        Node* tail_;
+        LockStatsRecorder stats_;
+    };
+
+    /** @brief IrqSpinLock is a TicketLock that also keeps interrupts
+     * disabled while held, for data shared with interrupt handlers.
+     * Without that, a handler spinning on a lock its own CPU holds
+     * would never return.
+     */
+    class IrqSpinLock
+    {
+        TicketLock lock_;
+        uint64_t flags_; // written by the holder only
+
+    public:
+        IrqSpinLock()
+            : flags_(0)
+        {}
+
+        ~IrqSpinLock() = default;
+        IrqSpinLock(const IrqSpinLock&) = delete;
+        IrqSpinLock& operator =(const IrqSpinLock&) = delete;
+
+        void Lock()
+        {
+            const auto flags = SaveAndDisableInterrupts();
+            lock_.Lock();
+            flags_ = flags;
+        }
+
+        bool TryLock()
+        {
+            const auto flags = SaveAndDisableInterrupts();
+            if (!lock_.TryLock())
+            {
+                RestoreInterrupts(flags);
+                return false;
+            }
+            flags_ = flags;
+            return true;
+        }
+
+        void Unlock()
+        {
+            const auto flags = flags_;
+            lock_.Unlock();
+            RestoreInterrupts(flags);
+        }
+
+        bool IsLocked() const
+        {
+            return lock_.IsLocked();
+        }
+
+        LockStatsRecorder& Stats()
+        {
+            return lock_.Stats();
         }
     };
 
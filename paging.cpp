@@ -0,0 +1,349 @@
+/** @file paging.cpp builds and maintains the kernel page tables.
+ */
+
+#include "paging.hpp"
+
+#include "asmfunc.h"
+#include "bitutil.hpp"
+#include "memory.hpp"
+
+extern "C" char __kernel_text_start[];
+extern "C" char __kernel_text_end[];
+
+namespace
+{
+    using namespace bitnos;
+    using namespace bitnos::paging;
+
+    const uint64_t kPresent = 1u << 0;
+    const uint64_t kWritable = 1u << 1;
+    const uint64_t kWriteThrough = 1u << 3; // PWT
+    const uint64_t kCacheDisable = 1u << 4; // PCD
+    const uint64_t kPageSize = 1u << 7;
+    const uint64_t kGlobal = 1u << 8;
+    const uint64_t kAddressMask = 0x000ffffffffff000u;
+    const uint64_t kFlagMask = ~kAddressMask;
+
+    const uint32_t kMsrPat = 0x277;
+    // PA0=WB, PA1=WC, PA2=UC-, PA3=UC, PA4=WB, PA5=WT, PA6=UC-, PA7=UC
+    const uint64_t kPatValue = 0x0007040600070106u;
+
+    const uint64_t kCR4PageGlobalEnable = 1u << 7;
+
+    const uintptr_t kMinIdentityMapBytes = 4ull * 1024 * 1024 * 1024;
+
+    uint64_t* pml4 = nullptr;
+    bool paging_initialized = false;
+    bool support_huge_pages = false;
+    bool tlb_flush_needed = false;
+
+    uint64_t CacheBits(MemoryType type)
+    {
+        switch (type)
+        {
+        case MemoryType::kWriteBack:
+            return 0;
+        case MemoryType::kWriteCombining:
+            return kWriteThrough;
+        case MemoryType::kUncacheable:
+            return kCacheDisable | kWriteThrough;
+        }
+        return kCacheDisable | kWriteThrough;
+    }
+
+    constexpr size_t EntryBytes(int level)
+    {
+        return kBytesPerPage << (9 * (level - 1));
+    }
+
+    constexpr size_t EntryIndex(uintptr_t virt, int level)
+    {
+        return (virt >> (12 + 9 * (level - 1))) & 0x1ffu;
+    }
+
+    uint64_t* TableOf(uint64_t entry)
+    {
+        return reinterpret_cast<uint64_t*>(entry & kAddressMask);
+    }
+
+    WithError<uint64_t*> NewTable()
+    {
+        auto frame = memory::AllocateZeroedFrame();
+        if (IsError(frame.error))
+        {
+            return {nullptr, frame.error};
+        }
+        return {reinterpret_cast<uint64_t*>(frame.value), errorcode::kSuccess};
+    }
+
+    void FreeTable(uint64_t* table, int level)
+    {
+        if (level > 1)
+        {
+            for (int i = 0; i < 512; ++i)
+            {
+                if ((table[i] & kPresent) && (table[i] & kPageSize) == 0)
+                {
+                    FreeTable(TableOf(table[i]), level - 1);
+                }
+            }
+        }
+        memory::frame_allocator->Free(
+            reinterpret_cast<uintptr_t>(table), memory::kOrder4KiB);
+    }
+
+    /** SplitLargePage replaces a large page entry at the given level
+     * with a table of 512 entries mapping the same range.
+     */
+    Error SplitLargePage(uint64_t& entry, int level)
+    {
+        auto table = NewTable();
+        if (IsError(table.error))
+        {
+            return table.error;
+        }
+
+        const uint64_t base = entry & kAddressMask;
+        uint64_t flags = entry & kFlagMask;
+        if (level - 1 == 1)
+        {
+            flags &= ~kPageSize;
+        }
+        for (int i = 0; i < 512; ++i)
+        {
+            table.value[i] = (base + i * EntryBytes(level - 1)) | flags;
+        }
+
+        entry = reinterpret_cast<uint64_t>(table.value) | kPresent | kWritable;
+        tlb_flush_needed = true;
+        return errorcode::kSuccess;
+    }
+
+    bool CanMapWhole(int level, uintptr_t virt, uintptr_t phys, size_t bytes)
+    {
+        if (level != 2 && !(level == 3 && support_huge_pages))
+        {
+            return false;
+        }
+        const auto entry_bytes = EntryBytes(level);
+        return virt % entry_bytes == 0 && phys % entry_bytes == 0
+            && bytes >= entry_bytes;
+    }
+
+    Error Map(uint64_t* table, int level,
+              uintptr_t virt, uintptr_t phys, size_t bytes, uint64_t flags)
+    {
+        while (bytes > 0)
+        {
+            auto& entry = table[EntryIndex(virt, level)];
+            const auto entry_bytes = EntryBytes(level);
+
+            if (level == 1 || CanMapWhole(level, virt, phys, bytes))
+            {
+                if (entry & kPresent)
+                {
+                    if (level > 1 && (entry & kPageSize) == 0)
+                    {
+                        FreeTable(TableOf(entry), level - 1);
+                    }
+                    tlb_flush_needed = true;
+                }
+                entry = phys | flags | kPresent | kWritable
+                    | (level > 1 ? kPageSize : 0);
+                virt += entry_bytes;
+                phys += entry_bytes;
+                bytes -= entry_bytes;
+                continue;
+            }
+
+            if ((entry & kPresent) == 0)
+            {
+                auto child = NewTable();
+                if (IsError(child.error))
+                {
+                    return child.error;
+                }
+                entry = reinterpret_cast<uint64_t>(child.value)
+                    | kPresent | kWritable;
+            }
+            else if (entry & kPageSize)
+            {
+                auto err = SplitLargePage(entry, level);
+                if (IsError(err))
+                {
+                    return err;
+                }
+            }
+
+            const size_t offset = virt % entry_bytes;
+            const size_t chunk =
+                bytes < entry_bytes - offset ? bytes : entry_bytes - offset;
+            auto err = Map(TableOf(entry), level - 1, virt, phys, chunk, flags);
+            if (IsError(err))
+            {
+                return err;
+            }
+            virt += chunk;
+            phys += chunk;
+            bytes -= chunk;
+        }
+        return errorcode::kSuccess;
+    }
+
+    void FlushTLB()
+    {
+        // toggling CR4.PGE also flushes global pages
+        const auto cr4 = GetCR4();
+        SetCR4(cr4 & ~kCR4PageGlobalEnable);
+        SetCR4(cr4 | kCR4PageGlobalEnable);
+    }
+
+    void SetGlobal(uintptr_t start, uintptr_t end)
+    {
+        uintptr_t virt = bitutil::ClearBits(start, kBytesPerPage - 1);
+        while (virt < end)
+        {
+            uint64_t* table = pml4;
+            int level = 4;
+            while (true)
+            {
+                auto& entry = table[EntryIndex(virt, level)];
+                if ((entry & kPresent) == 0)
+                {
+                    return;
+                }
+                if (level == 1 || (entry & kPageSize))
+                {
+                    entry |= kGlobal;
+                    break;
+                }
+                table = TableOf(entry);
+                --level;
+            }
+            virt = bitutil::ClearBits(virt, EntryBytes(level) - 1)
+                + EntryBytes(level);
+        }
+    }
+
+    bool CpuHasFeature(uint32_t leaf, int reg_index, int bit)
+    {
+        uint32_t regs[4];
+        CpuId(leaf & 0x80000000u, 0, regs);
+        if (regs[0] < leaf)
+        {
+            return false;
+        }
+        CpuId(leaf, 0, regs);
+        return (regs[reg_index] >> bit) & 1u;
+    }
+
+    Error IdentityMap(uintptr_t phys, size_t bytes, MemoryType type)
+    {
+        const auto start = bitutil::ClearBits(phys, kBytesPerPage - 1);
+        const auto end = bitutil::ClearBits(
+            phys + bytes + kBytesPerPage - 1, kBytesPerPage - 1);
+        return MapPages(start, start, end - start, type);
+    }
+}
+
+namespace bitnos::paging
+{
+    Error InitializePaging(const BootParam& param)
+    {
+        support_huge_pages = CpuHasFeature(0x80000001u, 3, 26);
+        if (!CpuHasFeature(1, 3, 16)) // PAT
+        {
+            return errorcode::kNotImplemented;
+        }
+
+        auto table = NewTable();
+        if (IsError(table.error))
+        {
+            return table.error;
+        }
+        pml4 = table.value;
+
+        uintptr_t top = kMinIdentityMapBytes;
+        const auto base = reinterpret_cast<uintptr_t>(param.memory_map);
+        for (size_t it = 0; it < param.memory_map_size;
+             it += param.memory_descriptor_size)
+        {
+            auto desc = reinterpret_cast<const EFI_MEMORY_DESCRIPTOR*>(base + it);
+            const uintptr_t end =
+                desc->PhysicalStart + desc->NumberOfPages * kBytesPerPage;
+            top = end > top ? end : top;
+        }
+        top = bitutil::ClearBits(top + kBytesPerHugePage - 1, kBytesPerHugePage - 1);
+
+        auto err = MapPages(0, 0, top, MemoryType::kWriteBack);
+        if (IsError(err))
+        {
+            return err;
+        }
+
+        for (size_t it = 0; it < param.memory_map_size;
+             it += param.memory_descriptor_size)
+        {
+            auto desc = reinterpret_cast<const EFI_MEMORY_DESCRIPTOR*>(base + it);
+            if (desc->Type == EfiMemoryMappedIO)
+            {
+                IdentityMap(desc->PhysicalStart,
+                    desc->NumberOfPages * kBytesPerPage,
+                    MemoryType::kUncacheable);
+            }
+        }
+
+        const auto mode = param.graphic_mode;
+        err = IdentityMap(mode->frame_buffer_base, mode->frame_buffer_size,
+            MemoryType::kWriteCombining);
+        if (IsError(err))
+        {
+            return err;
+        }
+
+        SetGlobal(reinterpret_cast<uintptr_t>(__kernel_text_start),
+            reinterpret_cast<uintptr_t>(__kernel_text_end));
+
+        WriteBackInvalidateCache();
+        WriteMSR(kMsrPat, kPatValue);
+        WriteBackInvalidateCache();
+
+        SetCR3(reinterpret_cast<uint64_t>(pml4));
+        FlushTLB();
+        paging_initialized = true;
+        tlb_flush_needed = false;
+        return errorcode::kSuccess;
+    }
+
+    Error MapPages(uintptr_t virt, uintptr_t phys, size_t bytes, MemoryType type)
+    {
+        if (pml4 == nullptr
+                || virt % kBytesPerPage != 0 || phys % kBytesPerPage != 0
+                || bytes % kBytesPerPage != 0)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        auto err = Map(pml4, 4, virt, phys, bytes, CacheBits(type));
+        if (paging_initialized && tlb_flush_needed)
+        {
+            FlushTLB();
+            tlb_flush_needed = false;
+        }
+        return err;
+    }
+
+    Error MapMmio(uintptr_t phys, size_t bytes)
+    {
+        if (!paging_initialized)
+        {
+            return errorcode::kInvalidValue;
+        }
+        return IdentityMap(phys, bytes, MemoryType::kUncacheable);
+    }
+
+    bool IsPagingInitialized()
+    {
+        return paging_initialized;
+    }
+}
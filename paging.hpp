@@ -0,0 +1,58 @@
+#ifndef PAGING_HPP_
+#define PAGING_HPP_
+
+/** @file paging.hpp provides the kernel's own 4-level page tables.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bootparam.h"
+#include "errorcode.hpp"
+
+namespace bitnos::paging
+{
+    const size_t kBytesPerPage = 4096;
+    const size_t kBytesPerLargePage = 2 * 1024 * 1024;
+    const size_t kBytesPerHugePage = 1024 * 1024 * 1024;
+
+    /*
+     * Memory types are selected by PWT/PCD of the page entries.
+     * IA32_PAT entry 1 is reprogrammed to write-combining.
+     */
+    enum class MemoryType
+    {
+        kWriteBack,      // PAT entry 0
+        kWriteCombining, // PAT entry 1
+        kUncacheable,    // PAT entry 3
+    };
+
+    /** @brief InitializePaging builds a PML4 and switches CR3 to it.
+     *
+     * Physical memory is identity mapped (at least 4 GiB) with 1 GiB pages,
+     * or 2 MiB pages if the CPU lacks them. The frame buffer is mapped
+     * write-combining, EfiMemoryMappedIO ranges uncacheable, and pages
+     * holding the kernel text are global.
+     * frame_allocator must be initialized in advance.
+     */
+    Error InitializePaging(const BootParam& param);
+
+    /** @brief MapPages maps [virt, virt + bytes) to [phys, phys + bytes).
+     *
+     * Addresses must be 4 KiB aligned. The largest pages the alignment
+     * allows are used, and large pages in the way are split.
+     */
+    Error MapPages(uintptr_t virt, uintptr_t phys, size_t bytes, MemoryType type);
+
+    /** @brief MapMmio identity maps a MMIO region as uncacheable.
+     * The region is extended to 4 KiB boundaries.
+     */
+    Error MapMmio(uintptr_t phys, size_t bytes);
+
+    /** @brief IsPagingInitialized returns true once the kernel's page tables
+     * are in use.
+     */
+    bool IsPagingInitialized();
+}
+
+#endif // PAGING_HPP_
@@ -17,7 +17,7 @@ namespace bitnos
          */
     public:
         ArrayQueue()
-            : read_pos_(0), write_pos_(0)
+            : read_pos_(0), write_pos_(0), count_(0)
         {}
 
         Error Push(const T& value)
@@ -53,6 +53,46 @@ namespace bitnos
             return errorcode::kSuccess;
         }
 
+        /** @brief PushN pushes as many of values[0..n) as fit.
+         *
+         * @return The number of values pushed.
+         */
+        size_t PushN(const T* values, size_t n)
+        {
+            if (n > N - count_)
+            {
+                n = N - count_;
+            }
+            for (size_t i = 0, pos = write_pos_; i < n; ++i)
+            {
+                data_[pos] = values[i];
+                pos = pos + 1 == N ? 0 : pos + 1;
+            }
+            count_ += n;
+            write_pos_ = (write_pos_ + n) % N;
+            return n;
+        }
+
+        /** @brief PopN moves up to n elements to values.
+         *
+         * @return The number of elements popped.
+         */
+        size_t PopN(T* values, size_t n)
+        {
+            if (n > count_)
+            {
+                n = count_;
+            }
+            for (size_t i = 0, pos = read_pos_; i < n; ++i)
+            {
+                values[i] = data_[pos];
+                pos = pos + 1 == N ? 0 : pos + 1;
+            }
+            count_ -= n;
+            read_pos_ = (read_pos_ + n) % N;
+            return n;
+        }
+
         size_t Count() const
         {
             return count_;
@@ -63,6 +103,226 @@ namespace bitnos
             return data_[read_pos_];
         }
     };
+
+    const size_t kCacheLineSize = 64;
+
+    /** @brief MpmcQueue is a bounded lock-free queue for any number of
+     * producers and consumers (D. Vyukov's algorithm).
+     *
+     * Each slot has a sequence number telling whether it is ready for
+     * the producer or the consumer of a given position, so a side only
+     * contends on its own position counter. The constructor must run;
+     * a zero-filled object is not a valid empty queue.
+     */
+    template <typename T, size_t N>
+    class MpmcQueue
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+        static const size_t kMask = N - 1;
+
+        struct Slot
+        {
+            size_t sequence;
+            T value;
+        };
+
+        alignas(kCacheLineSize) Slot slots_[N];
+        alignas(kCacheLineSize) size_t push_pos_;
+        alignas(kCacheLineSize) size_t pop_pos_;
+
+        static ptrdiff_t Diff(size_t a, size_t b)
+        {
+            return static_cast<ptrdiff_t>(a - b);
+        }
+
+        size_t LoadSequence(size_t pos) const
+        {
+            return __atomic_load_n(&slots_[pos & kMask].sequence, __ATOMIC_ACQUIRE);
+        }
+
+        /*
+         * Claim reserves up to n consecutive positions from *pos_ptr whose
+         * slots have sequence position + offset, with one CAS.
+         */
+        size_t Claim(size_t* pos_ptr, size_t offset, size_t n, size_t& start)
+        {
+            auto pos = __atomic_load_n(pos_ptr, __ATOMIC_RELAXED);
+            for (;;)
+            {
+                size_t k = 0;
+                while (k < n && LoadSequence(pos + k) == pos + k + offset)
+                {
+                    ++k;
+                }
+                if (k == 0)
+                {
+                    if (Diff(LoadSequence(pos), pos + offset) < 0)
+                    {
+                        return 0; // full or empty
+                    }
+                    // another thread took pos
+                    pos = __atomic_load_n(pos_ptr, __ATOMIC_RELAXED);
+                    continue;
+                }
+                if (__atomic_compare_exchange_n(pos_ptr, &pos, pos + k, true,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                {
+                    start = pos;
+                    return k;
+                }
+            }
+        }
+
+    public:
+        MpmcQueue()
+            : push_pos_(0), pop_pos_(0)
+        {
+            for (size_t i = 0; i < N; ++i)
+            {
+                slots_[i].sequence = i;
+            }
+        }
+
+        MpmcQueue(const MpmcQueue&) = delete;
+        MpmcQueue& operator =(const MpmcQueue&) = delete;
+
+        Error Push(const T& value)
+        {
+            return PushN(&value, 1) == 1 ? errorcode::kSuccess : errorcode::kFull;
+        }
+
+        Error Pop(T& value)
+        {
+            return PopN(&value, 1) == 1 ? errorcode::kSuccess : errorcode::kEmpty;
+        }
+
+        /** @brief PushN pushes up to n values, claiming them with a single
+         * update of the push position.
+         *
+         * @return The number of values pushed, 0 if the queue is full.
+         */
+        size_t PushN(const T* values, size_t n)
+        {
+            size_t start;
+            const auto k = Claim(&push_pos_, 0, n, start);
+            for (size_t i = 0; i < k; ++i)
+            {
+                auto& slot = slots_[(start + i) & kMask];
+                slot.value = values[i];
+                __atomic_store_n(&slot.sequence, start + i + 1, __ATOMIC_RELEASE);
+            }
+            return k;
+        }
+
+        /** @brief PopN pops up to n values in order, claiming them with a
+         * single update of the pop position.
+         *
+         * @return The number of values popped, 0 if the queue is empty.
+         */
+        size_t PopN(T* values, size_t n)
+        {
+            size_t start;
+            const auto k = Claim(&pop_pos_, 1, n, start);
+            for (size_t i = 0; i < k; ++i)
+            {
+                auto& slot = slots_[(start + i) & kMask];
+                values[i] = slot.value;
+                __atomic_store_n(&slot.sequence, start + i + N, __ATOMIC_RELEASE);
+            }
+            return k;
+        }
+
+        /** @brief Count returns an estimate of the number of elements.
+         */
+        size_t Count() const
+        {
+            const auto pop = __atomic_load_n(&pop_pos_, __ATOMIC_RELAXED);
+            const auto push = __atomic_load_n(&push_pos_, __ATOMIC_RELAXED);
+            return Diff(push, pop) > 0 ? push - pop : 0;
+        }
+    };
+
+    /** @brief SpscQueue is a lock-free ring for one producer and one consumer,
+     * e.g. an interrupt handler and the main loop.
+     *
+     * Push must only be called by the producer; Front and Pop only by
+     * the consumer. Neither side ever waits for the other. Each index is
+     * on its own cache line with the producer's or consumer's cached copy
+     * of the other index, so the sides share a line only to refresh that
+     * copy.
+     */
+    template <typename T, size_t N>
+    class SpscQueue
+    {
+        static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of two");
+        static const size_t kMask = N - 1;
+
+        // indices run freely; position is index & kMask
+        alignas(kCacheLineSize) size_t write_pos_;
+        size_t cached_read_pos_;
+        alignas(kCacheLineSize) size_t read_pos_;
+        size_t cached_write_pos_;
+        alignas(kCacheLineSize) T data_[N];
+
+    public:
+        SpscQueue()
+            : write_pos_(0), cached_read_pos_(0), read_pos_(0), cached_write_pos_(0)
+        {}
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator =(const SpscQueue&) = delete;
+
+        Error Push(const T& value)
+        {
+            const auto w = write_pos_;
+            if (w - cached_read_pos_ == N)
+            {
+                cached_read_pos_ = __atomic_load_n(&read_pos_, __ATOMIC_ACQUIRE);
+                if (w - cached_read_pos_ == N)
+                {
+                    return errorcode::kFull;
+                }
+            }
+
+            data_[w & kMask] = value;
+            __atomic_store_n(&write_pos_, w + 1, __ATOMIC_RELEASE);
+            return errorcode::kSuccess;
+        }
+
+        Error Pop()
+        {
+            const auto r = read_pos_;
+            if (r == cached_write_pos_)
+            {
+                cached_write_pos_ = __atomic_load_n(&write_pos_, __ATOMIC_ACQUIRE);
+                if (r == cached_write_pos_)
+                {
+                    return errorcode::kEmpty;
+                }
+            }
+
+            __atomic_store_n(&read_pos_, r + 1, __ATOMIC_RELEASE);
+            return errorcode::kSuccess;
+        }
+
+        /** @brief Count returns the number of elements at some point during
+         * the call.
+         */
+        size_t Count() const
+        {
+            // read first: write_pos_ never falls behind a read_pos_ seen earlier
+            const auto r = __atomic_load_n(&read_pos_, __ATOMIC_ACQUIRE);
+            return __atomic_load_n(&write_pos_, __ATOMIC_ACQUIRE) - r;
+        }
+
+        /** @brief Front returns the oldest element. The consumer must have
+         * seen a non-zero Count() beforehand.
+         */
+        const T& Front() const
+        {
+            return data_[read_pos_ & kMask];
+        }
+    };
 }
 
 #endif // QUEUE_HPP_
@@ -0,0 +1,214 @@
+/** @file slab.cpp implements the slab caches and the page information
+ * table which maps a frame back to its owner.
+ */
+
+#include "slab.hpp"
+
+#include <string.h>
+
+#include "bitutil.hpp"
+#include "memory.hpp"
+
+namespace
+{
+    using namespace bitnos;
+    using namespace bitnos::memory;
+
+    /*
+     * Page information of a frame.
+     *
+     * 0: not owned by the slab allocator
+     * 1 to kNumSlabCaches: owned by the slab cache (value - 1)
+     * kPageLarge | (num_frames << 8): head of a large object
+     */
+    using PageInfo = uint32_t;
+    const PageInfo kPageLarge = 0xffu;
+
+    // A page information table covers 1 GiB and is allocated on demand.
+    const size_t kFramesPerInfoTable = static_cast<size_t>(1) << kOrder1GiB;
+    const size_t kNumInfoTables = kMaxFrames / kFramesPerInfoTable;
+    PageInfo* page_info_tables[kNumInfoTables];
+
+    PageInfo GetPageInfo(uintptr_t addr)
+    {
+        const size_t frame = addr / kBytesPerFrame;
+        if (frame >= kMaxFrames)
+        {
+            return 0;
+        }
+        const auto table = page_info_tables[frame / kFramesPerInfoTable];
+        return table ? table[frame % kFramesPerInfoTable] : 0;
+    }
+
+    Error SetPageInfo(uintptr_t addr, PageInfo info)
+    {
+        const size_t frame = addr / kBytesPerFrame;
+        auto& table = page_info_tables[frame / kFramesPerInfoTable];
+        if (table == nullptr)
+        {
+            const size_t table_bytes = sizeof(PageInfo) * kFramesPerInfoTable;
+            auto mem = frame_allocator->AllocateFrames(table_bytes / kBytesPerFrame);
+            if (IsError(mem.error))
+            {
+                return mem.error;
+            }
+            table = reinterpret_cast<PageInfo*>(mem.value);
+            memset(table, 0, table_bytes);
+        }
+        table[frame % kFramesPerInfoTable] = info;
+        return errorcode::kSuccess;
+    }
+
+    char slab_caches_buf[kNumSlabCaches][sizeof(SlabCache)]
+        __attribute__((aligned(alignof(SlabCache))));
+    SlabCache* slab_caches[kNumSlabCaches];
+
+    LargeObjectStat large_object_stat;
+
+    size_t CacheIndex(size_t size)
+    {
+        if (size <= kMinSlabObjectSize)
+        {
+            return 0;
+        }
+        // index of the smallest power of two >= size, counted from 16 bytes
+        return bitutil::BitScanReverse(size - 1) + 1 - 4;
+    }
+
+    void* AllocateLarge(size_t size)
+    {
+        const size_t num_frames = (size + kBytesPerFrame - 1) / kBytesPerFrame;
+        auto mem = frame_allocator->AllocateFrames(num_frames);
+        if (IsError(mem.error))
+        {
+            return nullptr;
+        }
+        if (IsError(SetPageInfo(mem.value, kPageLarge | (num_frames << 8))))
+        {
+            frame_allocator->FreeFrames(mem.value, num_frames);
+            return nullptr;
+        }
+
+        ++large_object_stat.num_objects;
+        large_object_stat.num_frames += num_frames;
+        return reinterpret_cast<void*>(mem.value);
+    }
+
+    void FreeLarge(uintptr_t addr, size_t num_frames)
+    {
+        SetPageInfo(addr, 0);
+        frame_allocator->FreeFrames(addr, num_frames);
+        --large_object_stat.num_objects;
+        large_object_stat.num_frames -= num_frames;
+    }
+}
+
+namespace bitnos::memory
+{
+    SlabCache::SlabCache(size_t object_size, size_t cache_index)
+        : object_size_(object_size), cache_index_(cache_index),
+          free_list_(nullptr), num_in_use_(0), num_free_(0), num_frames_(0)
+    {}
+
+    Error SlabCache::Grow()
+    {
+        auto frame = frame_allocator->Allocate(kOrder4KiB);
+        if (IsError(frame.error))
+        {
+            return frame.error;
+        }
+        auto err = SetPageInfo(frame.value, cache_index_ + 1);
+        if (IsError(err))
+        {
+            frame_allocator->Free(frame.value, kOrder4KiB);
+            return err;
+        }
+
+        for (size_t offset = 0; offset + object_size_ <= kBytesPerFrame;
+             offset += object_size_)
+        {
+            auto obj = reinterpret_cast<FreeObject*>(frame.value + offset);
+            obj->next = free_list_;
+            free_list_ = obj;
+            ++num_free_;
+        }
+        ++num_frames_;
+        return errorcode::kSuccess;
+    }
+
+    void* SlabCache::Allocate()
+    {
+        if (free_list_ == nullptr && IsError(Grow()))
+        {
+            return nullptr;
+        }
+
+        auto obj = free_list_;
+        free_list_ = obj->next;
+        --num_free_;
+        ++num_in_use_;
+        return obj;
+    }
+
+    void SlabCache::Free(void* obj)
+    {
+        auto p = reinterpret_cast<FreeObject*>(obj);
+        p->next = free_list_;
+        free_list_ = p;
+        ++num_free_;
+        --num_in_use_;
+    }
+
+    void InitializeSlab()
+    {
+        for (size_t i = 0; i < kNumSlabCaches; ++i)
+        {
+            slab_caches[i] =
+                new(slab_caches_buf[i]) SlabCache(kMinSlabObjectSize << i, i);
+        }
+    }
+
+    void* AllocateObject(size_t size)
+    {
+        if (size > kMaxSlabObjectSize)
+        {
+            return AllocateLarge(size);
+        }
+
+        auto cache = slab_caches[CacheIndex(size)];
+        if (cache == nullptr)
+        {
+            return nullptr;
+        }
+        return cache->Allocate();
+    }
+
+    void FreeObject(void* obj)
+    {
+        if (obj == nullptr)
+        {
+            return;
+        }
+
+        const auto addr = reinterpret_cast<uintptr_t>(obj);
+        const auto info = GetPageInfo(addr);
+        if ((info & 0xffu) == kPageLarge)
+        {
+            FreeLarge(addr, info >> 8);
+        }
+        else if (0 < info && info <= kNumSlabCaches)
+        {
+            slab_caches[info - 1]->Free(obj);
+        }
+    }
+
+    const SlabCache& GetSlabCache(size_t index)
+    {
+        return *slab_caches[index];
+    }
+
+    LargeObjectStat GetLargeObjectStat()
+    {
+        return large_object_stat;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef SLAB_HPP_
+#define SLAB_HPP_
+
+/** @file slab.hpp provides the size-class object allocator
+ * behind the global operator new/delete.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "errorcode.hpp"
+
+namespace bitnos::memory
+{
+    /** @brief SlabCache hands out objects of one size from whole frames.
+     *
+     * Free objects are chained through their first word, so Allocate and
+     * Free are O(1). Frames taken by a cache are kept by the cache.
+     */
+    class SlabCache
+    {
+        struct FreeObject
+        {
+            FreeObject* next;
+        };
+
+        size_t object_size_;
+        size_t cache_index_;
+        FreeObject* free_list_;
+        size_t num_in_use_;
+        size_t num_free_;
+        size_t num_frames_;
+
+        Error Grow();
+
+    public:
+        SlabCache(size_t object_size, size_t cache_index);
+        SlabCache(const SlabCache&) = delete;
+        SlabCache& operator =(const SlabCache&) = delete;
+
+        /** @brief Allocate returns an object or nullptr if out of memory.
+         */
+        void* Allocate();
+
+        /** @brief Free returns an object obtained by Allocate of this cache.
+         */
+        void Free(void* obj);
+
+        size_t ObjectSize() const { return object_size_; }
+        size_t NumInUse() const { return num_in_use_; }
+        size_t NumFree() const { return num_free_; }
+        size_t NumFrames() const { return num_frames_; }
+    };
+
+    const size_t kMinSlabObjectSize = 16;
+    const size_t kMaxSlabObjectSize = 4096;
+    const size_t kNumSlabCaches = 9; // 16, 32, ..., 4096 bytes
+
+    struct LargeObjectStat
+    {
+        size_t num_objects;
+        size_t num_frames;
+    };
+
+    /** @brief InitializeSlab constructs the slab caches.
+     * frame_allocator must be initialized in advance.
+     */
+    void InitializeSlab();
+
+    /** @brief AllocateObject allocates size bytes.
+     *
+     * Sizes up to kMaxSlabObjectSize are served by the slab cache of the
+     * next power of two; larger ones go straight to frame_allocator.
+     *
+     * @return Pointer aligned to min(object size, 4 KiB), or nullptr.
+     */
+    void* AllocateObject(size_t size);
+
+    /** @brief FreeObject frees a pointer obtained by AllocateObject.
+     * nullptr and unknown pointers are ignored.
+     */
+    void FreeObject(void* obj);
+
+    const SlabCache& GetSlabCache(size_t index);
+    LargeObjectStat GetLargeObjectStat();
+}
+
+#endif // SLAB_HPP_
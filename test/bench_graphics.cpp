@@ -0,0 +1,165 @@
+/** @file bench_graphics.cpp measures graphics.cpp and debug_console.cpp on
+ * a frame buffer in ordinary host memory.
+ *
+ * Output: one line per (benchmark, pixel format) in the form
+ *   <benchmark> <format> <value> <unit>
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graphics.hpp"
+#include "debug_console.hpp"
+
+namespace
+{
+    using namespace bitnos;
+    using namespace bitnos::graphics;
+
+    const uint32_t kWidth = 1920;
+    const uint32_t kHeight = 1080;
+    const double kSecondsPerRun = 0.2;
+
+    /** Measure returns how many times f runs per second. */
+    template <typename F>
+    double Measure(F f)
+    {
+        f(); // warm up
+        size_t iterations = 0;
+        const auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed;
+        do
+        {
+            f();
+            ++iterations;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < kSecondsPerRun);
+        return iterations / elapsed.count();
+    }
+
+    template <class Writer>
+    void Run(const char* format, GraphicPixelFormat pixel_format)
+    {
+        auto frame_buffer = static_cast<uint32_t*>(
+            aligned_alloc(64, sizeof(uint32_t) * kWidth * kHeight));
+        GraphicMode mode = {};
+        mode.frame_buffer_base = reinterpret_cast<uintptr_t>(frame_buffer);
+        mode.frame_buffer_size = sizeof(uint32_t) * kWidth * kHeight;
+        mode.horizontal_resolution = kWidth;
+        mode.vertical_resolution = kHeight;
+        mode.pixel_format = pixel_format;
+        mode.pixels_per_scan_line = kWidth;
+        Writer writer(&mode);
+
+        const double screen_pixels = static_cast<double>(kWidth) * kHeight;
+        const Color kWhite = {255, 255, 255, 0};
+        const Color kBlue = {32, 64, 224, 0};
+
+        auto rate = Measure([&] { writer.FillRect({0, 0}, {kWidth, kHeight}, kWhite); });
+        printf("fill_white %s %.0f pixel/s\n", format, rate * screen_pixels);
+        rate = Measure([&] { writer.FillRect({0, 0}, {kWidth, kHeight}, kBlue); });
+        printf("fill_color %s %.0f pixel/s\n", format, rate * screen_pixels);
+
+        int n = 0;
+        rate = Measure([&]
+            {
+                const Point pos = {(n * 37) % 1800, (n * 53) % 960};
+                DrawRect(writer, pos, {100, 100}, kBlue);
+                ++n;
+            });
+        printf("draw_rect_100x100 %s %.0f pixel/s\n", format, rate * 100 * 100);
+
+        const int kCharsPerRow = kWidth / 8;
+        rate = Measure([&]
+            {
+                for (int i = 0; i < kCharsPerRow; ++i)
+                {
+                    DrawAscii(writer, {8 * i, 16 * (n % 60)}, 'A' + i % 26);
+                }
+                ++n;
+            });
+        printf("draw_ascii %s %.0f char/s\n", format, rate * kCharsPerRow);
+
+        GlyphCache glyphs(writer, {0, 0, 0, 0}, kWhite);
+        rate = Measure([&]
+            {
+                for (int i = 0; i < kCharsPerRow; ++i)
+                {
+                    glyphs.Draw({8 * i, 16 * (n % 60)}, 'A' + i % 26);
+                }
+                ++n;
+            });
+        printf("glyph_cache_draw %s %.0f char/s\n", format, rate * kCharsPerRow);
+
+        // console output within one screen, then with every line scrolling
+        const uint32_t rows = kHeight / 16;
+        const size_t line_len = 65;
+        char lines[26][line_len];
+        for (int i = 0; i < 26; ++i)
+        {
+            for (size_t j = 0; j < line_len - 1; ++j)
+            {
+                lines[i][j] = 'a' + (i + j) % 26;
+            }
+            lines[i][line_len - 1] = '\n';
+        }
+
+        {
+            size_t num_lines = 0;
+            std::chrono::duration<double> elapsed(0);
+            while (elapsed.count() < kSecondsPerRun)
+            {
+                DebugConsole cons(writer, {kWidth / 8, rows});
+                cons.Render();
+                const auto start = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < rows - 1; ++i)
+                {
+                    cons.Write(lines[i % 26], line_len);
+                    cons.Render();
+                }
+                elapsed += std::chrono::steady_clock::now() - start;
+                num_lines += rows - 1;
+            }
+            printf("console_line %s %.0f char/s\n", format,
+                   num_lines * line_len / elapsed.count());
+        }
+        {
+            DebugConsole cons(writer, {kWidth / 8, rows});
+            for (uint32_t i = 0; i < rows; ++i)
+            {
+                cons.Write(lines[i % 26], line_len);
+            }
+            cons.Render();
+            rate = Measure([&]
+                {
+                    cons.Write(lines[n++ % 26], line_len);
+                    cons.Render();
+                });
+            printf("console_scroll %s %.0f line/s\n", format, rate);
+        }
+
+        {
+            Compositor compositor(writer, kWhite);
+            auto layer = compositor.NewLayer({kWidth, kHeight});
+            compositor.SetVisible(*layer, true);
+            rate = Measure([&]
+                {
+                    layer->FillRect({0, 0}, {kWidth, kHeight}, kBlue);
+                    compositor.Compose();
+                });
+            printf("compose_full %s %.0f pixel/s\n", format, rate * screen_pixels);
+        }
+
+        free(frame_buffer);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Run<PixelWriterRedGreenBlueReserved8BitPerColor>(
+        "RGBX", kPixelRedGreenBlueReserved8BitPerColor);
+    Run<PixelWriterBlueGreenRedReserved8BitPerColor>(
+        "BGRX", kPixelBlueGreenRedReserved8BitPerColor);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/** @file bench_memfunc.cpp measures memcpy/memset variants of libc/memfunc.c.
+ *
+ * Output: one line per (function, variant, size) in the form
+ *   <function> <variant> <size bytes> <GB/s>
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libc/memfunc.h"
+
+namespace
+{
+    const size_t kSizes[] = {
+        64, 256, 1024, 4096, 16 * 1024, 64 * 1024, 256 * 1024,
+        1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024
+    };
+    const size_t kBytesPerRun = 1ull << 28;
+
+    template <typename F>
+    double Measure(size_t size, F f)
+    {
+        const size_t iterations = kBytesPerRun / size;
+        f(); // warm up
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            f();
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return iterations * size / elapsed.count() / 1e9;
+    }
+
+    struct MemcpyVariant
+    {
+        const char* name;
+        MemcpyFunc* func;
+    };
+
+    struct MemsetVariant
+    {
+        const char* name;
+        MemsetFunc* func;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    const bool avx2 = __builtin_cpu_supports("avx2");
+    const MemcpyVariant memcpy_variants[] = {
+        {"byte", memcpy_byte}, {"erms", memcpy_erms}, {"sse2", memcpy_sse2},
+        {"avx2", avx2 ? memcpy_avx2 : nullptr}, {"nt", memcpy_nt},
+    };
+    const MemsetVariant memset_variants[] = {
+        {"byte", memset_byte}, {"erms", memset_erms}, {"sse2", memset_sse2},
+        {"avx2", avx2 ? memset_avx2 : nullptr}, {"nt", memset_nt},
+    };
+
+    const size_t max_size = kSizes[sizeof(kSizes) / sizeof(kSizes[0]) - 1];
+    auto src = static_cast<unsigned char*>(aligned_alloc(64, max_size));
+    auto dst = static_cast<unsigned char*>(aligned_alloc(64, max_size));
+    memset(src, 1, max_size);
+    memset(dst, 2, max_size);
+
+    for (const auto& v : memcpy_variants)
+    {
+        for (size_t size : kSizes)
+        {
+            if (v.func == nullptr)
+            {
+                continue;
+            }
+            const auto gbps = Measure(size, [&] { v.func(dst, src, size); });
+            printf("memcpy %s %zu %.2f\n", v.name, size, gbps);
+        }
+    }
+
+    for (const auto& v : memset_variants)
+    {
+        for (size_t size : kSizes)
+        {
+            if (v.func == nullptr)
+            {
+                continue;
+            }
+            const auto gbps = Measure(size, [&] { v.func(dst, 0x5a, size); });
+            printf("memset %s %zu %.2f\n", v.name, size, gbps);
+        }
+    }
+
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef TEST_SCREEN_HPP_
+#define TEST_SCREEN_HPP_
+
+/** @file screen.hpp provides a frame buffer in host memory for the
+ * graphics and console tests.
+ */
+
+#include <memory>
+#include <vector>
+#include "graphics.hpp"
+
+namespace test
+{
+    using namespace bitnos::graphics;
+
+    /** CountingWriter counts the blits, which is how glyphs are drawn. */
+    class CountingWriter : public PixelWriterBlueGreenRedReserved8BitPerColor
+    {
+    public:
+        using PixelWriterBlueGreenRedReserved8BitPerColor::PixelWriterBlueGreenRedReserved8BitPerColor;
+
+        size_t num_blits = 0;
+        size_t num_blit_pixels = 0;
+
+        void Blit(const Point& position, const uint32_t* src,
+                  size_t src_stride, const RectSize& size) override
+        {
+            ++num_blits;
+            num_blit_pixels += size.width * size.height;
+            PixelWriterBlueGreenRedReserved8BitPerColor::Blit(position, src, src_stride, size);
+        }
+    };
+
+    struct Screen
+    {
+        const unsigned int width, height;
+        std::vector<uint32_t> pixels;
+        std::unique_ptr<CountingWriter> writer;
+
+        Screen(unsigned int width, unsigned int height)
+            : width(width), height(height), pixels(width * height, 0)
+        {
+            GraphicMode mode = {};
+            mode.frame_buffer_base = reinterpret_cast<uintptr_t>(pixels.data());
+            mode.frame_buffer_size = sizeof(uint32_t) * width * height;
+            mode.horizontal_resolution = width;
+            mode.vertical_resolution = height;
+            mode.pixel_format = kPixelBlueGreenRedReserved8BitPerColor;
+            mode.pixels_per_scan_line = width;
+            writer.reset(new CountingWriter(&mode));
+        }
+
+        uint32_t& At(int x, int y)
+        {
+            return pixels[width * y + x];
+        }
+
+        /** Count returns the number of pixels in the rectangle equal to color. */
+        int Count(Point pos, RectSize size, const Color& color)
+        {
+            int n = 0;
+            for (int y = pos.y; y < pos.y + static_cast<int>(size.height); ++y)
+            {
+                for (int x = pos.x; x < pos.x + static_cast<int>(size.width); ++x)
+                {
+                    n += At(x, y) == writer->Encode(color);
+                }
+            }
+            return n;
+        }
+
+        /** SameAs returns true if the rectangle at pos equals other's at
+         * other_pos. */
+        bool SameAs(Point pos, Screen& other, Point other_pos, RectSize size)
+        {
+            for (int dy = 0; dy < static_cast<int>(size.height); ++dy)
+            {
+                for (int dx = 0; dx < static_cast<int>(size.width); ++dx)
+                {
+                    if (At(pos.x + dx, pos.y + dy) !=
+                        other.At(other_pos.x + dx, other_pos.y + dy))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+}
+
+#endif // TEST_SCREEN_HPP_
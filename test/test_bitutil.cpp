@@ -18,6 +18,15 @@ TEST(Bitutil, bsf)
     CHECK_EQUAL(-1, bitutil::BitScanForward(0));
 }
 
+TEST(Bitutil, bsr)
+{
+    CHECK_EQUAL(0, bitutil::BitScanReverse(0x0001u));
+    CHECK_EQUAL(15, bitutil::BitScanReverse(0xa5c0u));
+    CHECK_EQUAL(63, bitutil::BitScanReverse(~static_cast<uint64_t>(0)));
+
+    CHECK_EQUAL(-1, bitutil::BitScanReverse(0));
+}
+
 TEST(Bitutil, clear_bits)
 {
     CHECK_EQUAL(0xdeadbeefdead0000,
@@ -0,0 +1,191 @@
+#include <CppUTest/CommandLineTestRunner.h>
+#include <string>
+#include "debug_console.hpp"
+#include "screen.hpp"
+
+using bitnos::DebugConsole;
+using test::Screen;
+
+namespace
+{
+    const unsigned int kColumns = 10;
+    const unsigned int kRows = 4;
+    const char* const kWide = "\xe4\xb8\x80"; // U+4E00, full-width
+
+    /** Glyphs holds every hankaku glyph drawn the way the console draws. */
+    struct Glyphs
+    {
+        Screen screen{8 * 256, 16};
+
+        Glyphs()
+        {
+            bitnos::graphics::GlyphCache cache(*screen.writer, {0, 0, 0, 0}, {255, 255, 255, 0});
+            for (int ch = 0; ch < 256; ++ch)
+            {
+                cache.Draw({8 * ch, 0}, ch);
+            }
+        }
+    };
+
+    Glyphs* glyphs;
+}
+
+TEST_GROUP(DebugConsole) {
+    Screen* screen;
+    DebugConsole* cons;
+
+    TEST_SETUP()
+    {
+        if (glyphs == nullptr)
+        {
+            glyphs = new Glyphs;
+        }
+        screen = new Screen(8 * kColumns, 16 * kRows);
+        cons = new DebugConsole(*screen->writer, {kColumns, kRows});
+    }
+
+    TEST_TEARDOWN()
+    {
+        delete cons;
+        delete screen;
+    }
+
+    /** CharAt returns the printable character drawn at a cell, or '#'. */
+    char CharAt(int x, int y)
+    {
+        for (int ch = ' '; ch < 0x7f; ++ch)
+        {
+            if (screen->SameAs({8 * x, 16 * y}, glyphs->screen, {8 * ch, 0}, {8, 16}))
+            {
+                return ch;
+            }
+        }
+        return '#';
+    }
+
+    std::string RowText(int y)
+    {
+        std::string text;
+        for (unsigned int x = 0; x < kColumns; ++x)
+        {
+            text += CharAt(x, y);
+        }
+        return text;
+    }
+
+    /** IsWide returns true if the full-width code is drawn at a cell. */
+    bool IsWide(int x, int y, char32_t code)
+    {
+        Screen expected(16, 16);
+        bitnos::graphics::WideGlyphCache cache(*expected.writer, {0, 0, 0, 0}, {255, 255, 255, 0});
+        cache.Draw({0, 0}, code);
+        return screen->SameAs({8 * x, 16 * y}, expected, {0, 0}, {16, 16});
+    }
+};
+
+TEST(DebugConsole, WriteAndRender)
+{
+    cons->PutStr("abc");
+    cons->Render();
+    STRCMP_EQUAL("abc_      ", RowText(0).c_str());
+    STRCMP_EQUAL("          ", RowText(1).c_str());
+}
+
+TEST(DebugConsole, WrapsAtLastColumn)
+{
+    cons->PutStr("0123456789ab");
+    cons->Render();
+    STRCMP_EQUAL("0123456789", RowText(0).c_str());
+    STRCMP_EQUAL("ab_       ", RowText(1).c_str());
+}
+
+TEST(DebugConsole, ScrollsThroughTheRing)
+{
+    // more than two rounds of the 4 row ring
+    for (char c = 'a'; c <= 'j'; ++c)
+    {
+        const char line[] = {c, c, '\n', 0};
+        cons->PutStr(line);
+        if (c == 'e')
+        {
+            cons->Render();
+            STRCMP_EQUAL("cc        ", RowText(0).c_str());
+        }
+    }
+    cons->Render();
+    STRCMP_EQUAL("hh        ", RowText(0).c_str());
+    STRCMP_EQUAL("ii        ", RowText(1).c_str());
+    STRCMP_EQUAL("jj        ", RowText(2).c_str());
+    STRCMP_EQUAL("_         ", RowText(3).c_str());
+}
+
+TEST(DebugConsole, BackspaceToPreviousRow)
+{
+    cons->PutStr("abc\b");
+    cons->Render();
+    STRCMP_EQUAL("ab_       ", RowText(0).c_str());
+
+    cons->PutStr("cdefghij\b"); // wraps to row 1, then back
+    cons->Render();
+    STRCMP_EQUAL("abcdefghi_", RowText(0).c_str());
+    STRCMP_EQUAL("          ", RowText(1).c_str());
+}
+
+TEST(DebugConsole, FullWidthTakesTwoCells)
+{
+    cons->PutStr("a");
+    cons->PutStr(kWide);
+    cons->PutStr("b");
+    cons->Render();
+    CHECK_EQUAL('a', CharAt(0, 0));
+    CHECK_TRUE(IsWide(1, 0, 0x4e00));
+    CHECK_EQUAL('b', CharAt(3, 0));
+    CHECK_EQUAL('_', CharAt(4, 0));
+
+    // one backspace removes both halves
+    cons->PutStr("\b\b");
+    cons->Render();
+    STRCMP_EQUAL("a_        ", RowText(0).c_str());
+
+    // from the right half, backspace steps over the left one too
+    cons->PutStr(kWide);
+    cons->PutStr("\b\bx");
+    cons->Render();
+    STRCMP_EQUAL("x_        ", RowText(0).c_str());
+}
+
+TEST(DebugConsole, FullWidthAtLastColumnWraps)
+{
+    cons->PutStr("012345678");
+    cons->PutStr(kWide);
+    cons->Render();
+    STRCMP_EQUAL("012345678 ", RowText(0).c_str());
+    CHECK_TRUE(IsWide(0, 1, 0x4e00));
+    CHECK_EQUAL('_', CharAt(2, 1));
+}
+
+TEST(DebugConsole, RenderDrawsOnlyChangedCells)
+{
+    cons->PutStr("abc");
+    cons->Render();
+    auto& writer = *screen->writer;
+
+    writer.num_blits = writer.num_blit_pixels = 0;
+    cons->Render();
+    CHECK_EQUAL(0, writer.num_blits);
+
+    // the new character and the cursor are one run of two cells
+    cons->PutChar('d');
+    cons->Render();
+    CHECK_EQUAL(1, writer.num_blits);
+    CHECK_EQUAL(2 * 8 * 16, writer.num_blit_pixels);
+    STRCMP_EQUAL("abcd_     ", RowText(0).c_str());
+
+    // a scroll changes every row, and redraws only cells that differ
+    writer.num_blits = writer.num_blit_pixels = 0;
+    cons->PutStr("\n\n\n\n");
+    cons->Render();
+    CHECK_EQUAL(2, writer.num_blits);
+    STRCMP_EQUAL("          ", RowText(0).c_str());
+    STRCMP_EQUAL("_         ", RowText(3).c_str());
+}
@@ -0,0 +1,215 @@
+#include <CppUTest/CommandLineTestRunner.h>
+#include <sys/mman.h>
+#include "memory.hpp"
+
+using namespace bitnos::memory;
+
+namespace
+{
+    /*
+     * Free frames hold the list nodes and addresses are used as pointers,
+     * so the frames under test are mapped at their own "physical" address.
+     * 2 GiB from 2 GiB up is reserved, which is a pair of kMaxOrder buddies;
+     * only the pages of block heads are ever touched.
+     */
+    const uintptr_t kBase = 0x80000000;
+    const size_t kMappedFrames = 2 * (size_t{1} << kMaxOrder);
+
+    bool MapFrames()
+    {
+        static bool mapped = false;
+        if (!mapped)
+        {
+            auto p = mmap(reinterpret_cast<void*>(kBase), kMappedFrames * kBytesPerFrame,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE,
+                          -1, 0);
+            mapped = p == reinterpret_cast<void*>(kBase);
+        }
+        return mapped;
+    }
+
+    uintptr_t Frame(size_t i)
+    {
+        return kBase + i * kBytesPerFrame;
+    }
+
+    // a cache of one frame for the reclaimer test
+    FrameAllocator* cache_owner;
+    uintptr_t cached_frame;
+    int num_reclaims;
+
+    size_t ReclaimCachedFrame()
+    {
+        ++num_reclaims;
+        if (cached_frame == 0)
+        {
+            return 0;
+        }
+        cache_owner->Free(cached_frame, kOrder4KiB);
+        cached_frame = 0;
+        return 1;
+    }
+}
+
+TEST_GROUP(FrameAllocator) {
+    FrameAllocator* alloc;
+
+    TEST_SETUP()
+    {
+        CHECK_TRUE(MapFrames());
+        alloc = new FrameAllocator;
+    }
+
+    TEST_TEARDOWN()
+    {
+        delete alloc;
+    }
+};
+
+TEST(FrameAllocator, AllocateSplitsAndFreeCoalesces)
+{
+    alloc->AddRange(kBase, 1024);
+    CHECK_EQUAL(1024, alloc->NumTotalFrames());
+    CHECK_EQUAL(1024, alloc->NumFreeFrames());
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(10));
+
+    auto a = alloc->Allocate(kOrder4KiB);
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, a.error);
+    CHECK_EQUAL(kBase, a.value);
+    // the order 10 block was split once per order down to 0
+    CHECK_EQUAL(0, alloc->NumFreeBlocks(10));
+    for (unsigned int order = 0; order < 10; ++order)
+    {
+        CHECK_EQUAL(1, alloc->NumFreeBlocks(order));
+    }
+    CHECK_EQUAL(1023, alloc->NumFreeFrames());
+
+    // the lowest buddy is taken next
+    auto b = alloc->Allocate(kOrder4KiB);
+    CHECK_EQUAL(Frame(1), b.value);
+    CHECK_EQUAL(0, alloc->NumFreeBlocks(0));
+
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->Free(a.value, kOrder4KiB));
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(0)); // buddy still in use
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->Free(b.value, kOrder4KiB));
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(10));
+    for (unsigned int order = 0; order < 10; ++order)
+    {
+        CHECK_EQUAL(0, alloc->NumFreeBlocks(order));
+    }
+    CHECK_EQUAL(1024, alloc->NumFreeFrames());
+}
+
+TEST(FrameAllocator, BlocksAreAlignedToTheirSize)
+{
+    alloc->AddRange(Frame(1), 1023); // start off the order 10 boundary
+    for (unsigned int order : {0u, 3u, 1u, 5u, 2u, kOrder2MiB - 1})
+    {
+        auto block = alloc->Allocate(order);
+        CHECK_EQUAL(bitnos::errorcode::kSuccess, block.error);
+        CHECK_EQUAL(0, block.value % (kBytesPerFrame << order));
+        CHECK_TRUE(Frame(1) <= block.value);
+        CHECK_TRUE(block.value + (kBytesPerFrame << order) <= Frame(1024));
+    }
+}
+
+TEST(FrameAllocator, AddRangeSplitsIntoAlignedBlocks)
+{
+    // 3, 4-7, 8-15, 16-17
+    alloc->AddRange(Frame(3), 15);
+    CHECK_EQUAL(15, alloc->NumFreeFrames());
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(0));
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(1));
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(2));
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(3));
+    CHECK_EQUAL(0, alloc->NumFreeBlocks(4));
+
+    auto block = alloc->Allocate(3);
+    CHECK_EQUAL(Frame(8), block.value);
+    CHECK_EQUAL(bitnos::errorcode::kNoEnoughMemory, alloc->Allocate(3).error);
+}
+
+TEST(FrameAllocator, AllocateFramesGivesBackTheRest)
+{
+    alloc->AddRange(kBase, 16);
+
+    auto a = alloc->AllocateFrames(5);
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, a.error);
+    CHECK_EQUAL(kBase, a.value); // aligned to 8 frames
+    CHECK_EQUAL(11, alloc->NumFreeFrames());
+
+    // frames 5, 6-7 came back and serve small requests
+    CHECK_EQUAL(Frame(5), alloc->Allocate(0).value);
+    CHECK_EQUAL(Frame(6), alloc->Allocate(1).value);
+
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->FreeFrames(a.value, 5));
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->Free(Frame(5), 0));
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->Free(Frame(6), 1));
+    CHECK_EQUAL(16, alloc->NumFreeFrames());
+    CHECK_EQUAL(1, alloc->NumFreeBlocks(4));
+
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->AllocateFrames(0).error);
+}
+
+TEST(FrameAllocator, RunsOutOfMemory)
+{
+    alloc->AddRange(kBase, 4);
+    CHECK_EQUAL(bitnos::errorcode::kNoEnoughMemory, alloc->Allocate(3).error);
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->Allocate(2).error);
+    CHECK_EQUAL(bitnos::errorcode::kNoEnoughMemory, alloc->Allocate(0).error);
+    CHECK_EQUAL(0, alloc->NumFreeFrames());
+}
+
+TEST(FrameAllocator, RejectsBadArguments)
+{
+    alloc->AddRange(kBase, 8);
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->Allocate(kMaxOrder + 1).error);
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->Free(kBase, kMaxOrder + 1));
+
+    auto block = alloc->Allocate(1);
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->Free(block.value + kBytesPerFrame, 1));
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->Free(kMaxPhysicalMemoryBytes, 0));
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->FreeFrames(kBase + 1, 1));
+
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, alloc->Free(block.value, 1));
+    CHECK_EQUAL(bitnos::errorcode::kInvalidValue, alloc->Free(block.value, 1)); // double free
+    CHECK_EQUAL(8, alloc->NumFreeFrames());
+}
+
+TEST(FrameAllocator, BlocksStopMergingAtMaxOrder)
+{
+    alloc->AddRange(kBase, kMappedFrames);
+    CHECK_EQUAL(2, alloc->NumFreeBlocks(kMaxOrder)); // buddies, not merged
+
+    auto a = alloc->Allocate(kMaxOrder);
+    auto b = alloc->Allocate(kMaxOrder);
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, b.error);
+    CHECK_EQUAL(bitnos::errorcode::kNoEnoughMemory, alloc->Allocate(0).error);
+
+    alloc->Free(a.value, kMaxOrder);
+    alloc->Free(b.value, kMaxOrder);
+    CHECK_EQUAL(2, alloc->NumFreeBlocks(kMaxOrder));
+    CHECK_EQUAL(kMappedFrames, alloc->NumFreeFrames());
+}
+
+TEST(FrameAllocator, ReclaimsBeforeFailing)
+{
+    alloc->AddRange(kBase, 2);
+    cache_owner = alloc;
+    num_reclaims = 0;
+    alloc->SetReclaimer(ReclaimCachedFrame);
+
+    cached_frame = alloc->Allocate(kOrder4KiB).value;
+    auto a = alloc->Allocate(kOrder4KiB);
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, a.error);
+    CHECK_EQUAL(0, num_reclaims); // not needed yet
+
+    auto b = alloc->Allocate(kOrder4KiB);
+    CHECK_EQUAL(bitnos::errorcode::kSuccess, b.error);
+    CHECK_EQUAL(Frame(0), b.value);
+    CHECK_EQUAL(1, num_reclaims);
+
+    CHECK_EQUAL(bitnos::errorcode::kNoEnoughMemory, alloc->Allocate(kOrder4KiB).error);
+    CHECK_EQUAL(2, num_reclaims);
+}
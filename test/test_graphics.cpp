@@ -0,0 +1,179 @@
+#include <CppUTest/CommandLineTestRunner.h>
+#include "graphics.hpp"
+#include "screen.hpp"
+
+using namespace bitnos::graphics;
+using test::Screen;
+
+namespace
+{
+    const Color kWhite = {255, 255, 255, 0};
+    const Color kRed = {255, 0, 0, 0};
+    const Color kGreen = {0, 255, 0, 0};
+    const Color kBlue = {0, 0, 255, 0};
+
+    uint32_t Encode(const Color& color)
+    {
+        return BGRXFormat::Encode(color);
+    }
+
+    void CheckRegion(const DirtyRegions::Region& r, int x0, int y0, int x1, int y1)
+    {
+        CHECK_EQUAL(x0, r.x0);
+        CHECK_EQUAL(y0, r.y0);
+        CHECK_EQUAL(x1, r.x1);
+        CHECK_EQUAL(y1, r.y1);
+    }
+}
+
+TEST_GROUP(DirtyRegions) {
+    DirtyRegions dirty;
+    const RectSize bounds = {100, 100};
+
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(DirtyRegions, ClipsToBounds)
+{
+    dirty.Add({-5, -5}, {10, 10}, bounds);
+    dirty.Add({95, 98}, {10, 10}, bounds);
+    dirty.Add({200, 0}, {10, 10}, bounds);
+    dirty.Add({10, 10}, {0, 5}, bounds);
+    CHECK_EQUAL(2, dirty.Size());
+    CheckRegion(dirty[0], 0, 0, 5, 5);
+    CheckRegion(dirty[1], 95, 98, 100, 100);
+}
+
+TEST(DirtyRegions, MergesTouching)
+{
+    dirty.Add({0, 0}, {10, 10}, bounds);
+    dirty.Add({10, 0}, {10, 10}, bounds); // shares an edge
+    dirty.Add({50, 50}, {5, 5}, bounds);
+    CHECK_EQUAL(2, dirty.Size());
+    CheckRegion(dirty[0], 0, 0, 20, 10);
+    CheckRegion(dirty[1], 50, 50, 55, 55);
+}
+
+TEST(DirtyRegions, GrownRegionAbsorbsMore)
+{
+    dirty.Add({0, 0}, {10, 10}, bounds);
+    dirty.Add({20, 0}, {10, 10}, bounds);
+    CHECK_EQUAL(2, dirty.Size());
+    dirty.Add({5, 0}, {20, 5}, bounds); // bridges both
+    CHECK_EQUAL(1, dirty.Size());
+    CheckRegion(dirty[0], 0, 0, 30, 10);
+}
+
+TEST(DirtyRegions, FullListMergesWhereLeastGrows)
+{
+    for (int i = 0; i < DirtyRegions::kMaxRegions; ++i)
+    {
+        dirty.Add({10 * i, 0}, {2, 2}, bounds);
+    }
+    CHECK_EQUAL(DirtyRegions::kMaxRegions, dirty.Size());
+
+    dirty.Add({34, 0}, {2, 2}, bounds); // closest to the region at x 30
+    CHECK_EQUAL(DirtyRegions::kMaxRegions, dirty.Size());
+    for (int i = 0; i < dirty.Size(); ++i)
+    {
+        const int x0 = dirty[i].x0;
+        CheckRegion(dirty[i], x0, 0, x0 == 30 ? 36 : x0 + 2, 2);
+    }
+
+    dirty.Clear();
+    CHECK_EQUAL(0, dirty.Size());
+}
+
+TEST_GROUP(Compositor) {
+    Screen* screen;
+    Compositor* compositor;
+
+    TEST_SETUP()
+    {
+        screen = new Screen(40, 20);
+        compositor = new Compositor(*screen->writer, kWhite);
+    }
+
+    TEST_TEARDOWN()
+    {
+        delete compositor;
+        delete screen;
+    }
+
+    Layer* AddLayer(const Point& pos, const RectSize& size, const Color& color)
+    {
+        auto layer = compositor->NewLayer(size);
+        CHECK(layer != nullptr);
+        layer->FillRect({0, 0}, size, color);
+        compositor->MoveLayer(*layer, pos);
+        compositor->SetVisible(*layer, true);
+        return layer;
+    }
+};
+
+TEST(Compositor, Background)
+{
+    auto layer = compositor->NewLayer({10, 10});
+    layer->FillRect({0, 0}, {10, 10}, kRed); // hidden: not shown
+    compositor->Damage({0, 0}, {40, 20});
+    compositor->Compose();
+    CHECK_EQUAL(40 * 20, screen->Count({0, 0}, {40, 20}, kWhite));
+}
+
+TEST(Compositor, OpaqueLayersOcclude)
+{
+    AddLayer({0, 0}, {40, 20}, kRed);
+    auto top = AddLayer({5, 5}, {10, 10}, kBlue);
+    compositor->Compose();
+    CHECK_EQUAL(100, screen->Count({5, 5}, {10, 10}, kBlue));
+    CHECK_EQUAL(40 * 20 - 100, screen->Count({0, 0}, {40, 20}, kRed));
+
+    // partly off the screen; the old place shows the layer below again
+    compositor->MoveLayer(*top, {35, 15});
+    compositor->Compose();
+    CHECK_EQUAL(25, screen->Count({0, 0}, {40, 20}, kBlue));
+    CHECK_EQUAL(25, screen->Count({35, 15}, {5, 5}, kBlue));
+    CHECK_EQUAL(100, screen->Count({5, 5}, {10, 10}, kRed));
+
+    compositor->SetVisible(*top, false);
+    compositor->Compose();
+    CHECK_EQUAL(40 * 20, screen->Count({0, 0}, {40, 20}, kRed));
+}
+
+TEST(Compositor, TransparentColorShowsBelow)
+{
+    AddLayer({0, 0}, {20, 20}, kRed);
+    auto top = AddLayer({10, 0}, {20, 10}, kGreen);
+    top->SetTransparentColor(kGreen);
+    top->Write({0, 0}, kBlue);
+    top->Write({15, 5}, kBlue);
+    compositor->Damage({0, 0}, {40, 20});
+    compositor->Compose();
+
+    CHECK_EQUAL(Encode(kBlue), screen->At(10, 0));
+    CHECK_EQUAL(Encode(kBlue), screen->At(25, 5));
+    CHECK_EQUAL(0, screen->Count({0, 0}, {40, 20}, kGreen));
+    // red where the layer below is, the background past it
+    CHECK_EQUAL(20 * 20 - 1, screen->Count({0, 0}, {20, 20}, kRed));
+    CHECK_EQUAL(20 * 20 - 1, screen->Count({20, 0}, {20, 20}, kWhite));
+}
+
+TEST(Compositor, RedrawsOnlyDamage)
+{
+    auto layer = AddLayer({0, 0}, {40, 20}, kRed);
+    compositor->Compose();
+
+    // pixels outside the damage are not recomposed
+    screen->At(0, 0) = 0;
+    layer->FillRect({10, 10}, {2, 2}, kBlue);
+    compositor->Compose();
+    CHECK_EQUAL(0, screen->At(0, 0));
+    CHECK_EQUAL(4, screen->Count({10, 10}, {2, 2}, kBlue));
+
+    compositor->Compose(); // nothing damaged
+    CHECK_EQUAL(0, screen->At(0, 0));
+}
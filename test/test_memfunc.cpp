@@ -0,0 +1,136 @@
+#include <CppUTest/CommandLineTestRunner.h>
+#include <string.h>
+#include "libc/memfunc.h"
+
+namespace
+{
+    const size_t kBufSize = 4096 + 64;
+    const size_t kSizes[] = {
+        0, 1, 2, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+        127, 128, 129, 255, 1000, 2048, 4096
+    };
+
+    void Fill(unsigned char* buf, size_t n, unsigned int seed)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            buf[i] = static_cast<unsigned char>(seed * 31 + i * 7);
+        }
+    }
+
+    void CheckMemcpy(MemcpyFunc* f)
+    {
+        unsigned char src[kBufSize], dst[kBufSize], expected[kBufSize];
+        for (size_t n : kSizes)
+        {
+            for (size_t align = 0; align < 16; align += 3)
+            {
+                Fill(src, kBufSize, n);
+                Fill(dst, kBufSize, n + 1);
+                memcpy(expected, dst, kBufSize);
+                memcpy(expected + align, src + 16 - align, n);
+
+                CHECK_EQUAL(dst + align, f(dst + align, src + 16 - align, n));
+                MEMCMP_EQUAL(expected, dst, kBufSize);
+            }
+        }
+    }
+
+    void CheckMemset(MemsetFunc* f)
+    {
+        unsigned char dst[kBufSize], expected[kBufSize];
+        for (size_t n : kSizes)
+        {
+            for (size_t align = 0; align < 16; align += 5)
+            {
+                Fill(dst, kBufSize, n);
+                memcpy(expected, dst, kBufSize);
+                memset(expected + align, 0xa5, n);
+
+                CHECK_EQUAL(dst + align, f(dst + align, 0xa5, n));
+                MEMCMP_EQUAL(expected, dst, kBufSize);
+            }
+        }
+    }
+}
+
+TEST_GROUP(Memfunc) {
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(Memfunc, Memcpy)
+{
+    CheckMemcpy(memcpy_byte);
+    CheckMemcpy(memcpy_erms);
+    CheckMemcpy(memcpy_sse2);
+    CheckMemcpy(memcpy_nt);
+    if (__builtin_cpu_supports("avx2"))
+    {
+        CheckMemcpy(memcpy_avx2);
+    }
+}
+
+TEST(Memfunc, Memset)
+{
+    CheckMemset(memset_byte);
+    CheckMemset(memset_erms);
+    CheckMemset(memset_sse2);
+    CheckMemset(memset_nt);
+    if (__builtin_cpu_supports("avx2"))
+    {
+        CheckMemset(memset_avx2);
+    }
+}
+
+TEST(Memfunc, MemmoveOverlap)
+{
+    const size_t buf_size = kBufSize + 128;
+    unsigned char buf[buf_size], expected[buf_size];
+    for (size_t n : kSizes)
+    {
+        for (int shift : {-17, -16, -1, 1, 5, 16, 33})
+        {
+            Fill(buf, buf_size, n);
+            memcpy(expected, buf, buf_size);
+            memmove(expected + 64 + shift, expected + 64, n);
+
+            memmove_sse2(buf + 64 + shift, buf + 64, n);
+            MEMCMP_EQUAL(expected, buf, buf_size);
+        }
+    }
+}
+
+TEST(Memfunc, Memcmp)
+{
+    unsigned char a[256], b[256];
+    Fill(a, sizeof(a), 1);
+    memcpy(b, a, sizeof(b));
+    CHECK_EQUAL(0, memcmp_sse2(a, b, sizeof(a)));
+
+    for (size_t i : {0, 5, 15, 16, 100, 255})
+    {
+        memcpy(b, a, sizeof(b));
+        b[i] = a[i] + 1;
+        CHECK_TRUE(memcmp_sse2(a, b, sizeof(a)) < 0);
+        CHECK_TRUE(memcmp_sse2(b, a, sizeof(a)) > 0);
+        CHECK_EQUAL(0, memcmp_sse2(a, b, i));
+    }
+}
+
+TEST(Memfunc, Strlen)
+{
+    char buf[128];
+    for (size_t offset = 0; offset < 16; ++offset)
+    {
+        for (size_t len : {0, 1, 15, 16, 17, 50})
+        {
+            memset(buf, 'x', sizeof(buf));
+            buf[offset + len] = '\0';
+            CHECK_EQUAL(len, strlen_sse2(buf + offset));
+        }
+    }
+}
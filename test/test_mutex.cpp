@@ -1,5 +1,9 @@
 #include <CppUTest/CommandLineTestRunner.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
 #include <thread>
+#include <vector>
 #include "mutex.hpp"
 
 TEST_GROUP(Mutex) {
@@ -56,3 +60,166 @@ TEST(Mutex, LockGuard)
     }
     CHECK_TRUE(!m.IsLocked());
 }
+
+TEST(Mutex, TryLock)
+{
+    CHECK_TRUE(m.TryLock());
+    CHECK_FALSE(m.TryLock());
+    m.Unlock();
+    CHECK_TRUE(m.TryLock());
+    m.Unlock();
+}
+
+TEST_GROUP(TicketLock) {
+    bitnos::TicketLock m;
+
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(TicketLock, LockTryLock)
+{
+    CHECK_FALSE(m.IsLocked());
+    m.Lock();
+    CHECK_TRUE(m.IsLocked());
+    CHECK_FALSE(m.TryLock());
+    m.Unlock();
+    CHECK_FALSE(m.IsLocked());
+    CHECK_TRUE(m.TryLock());
+    m.Unlock();
+
+    const auto& stats = m.Stats().Stats();
+    CHECK_EQUAL(2, stats.acquisitions);
+    CHECK_EQUAL(0, stats.contended);
+}
+
+TEST_GROUP(McsLock) {
+    bitnos::McsLock m;
+
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(McsLock, LockTryLock)
+{
+    bitnos::McsLock::Node a, b;
+    CHECK_FALSE(m.IsLocked());
+    m.Lock(a);
+    CHECK_TRUE(m.IsLocked());
+    CHECK_FALSE(m.TryLock(b));
+    m.Unlock(a);
+    CHECK_FALSE(m.IsLocked());
+    {
+        bitnos::McsLock::Guard guard(m);
+        CHECK_TRUE(m.IsLocked());
+    }
+    CHECK_FALSE(m.IsLocked());
+    CHECK_EQUAL(2, m.Stats().Stats().acquisitions);
+}
+
+namespace
+{
+    template <typename Mutex>
+    struct Locker
+    {
+        Mutex& lock;
+        void Lock() { lock.Lock(); }
+        void Unlock() { lock.Unlock(); }
+    };
+
+    template <>
+    struct Locker<bitnos::McsLock>
+    {
+        bitnos::McsLock& lock;
+        bitnos::McsLock::Node node;
+        void Lock() { lock.Lock(node); }
+        void Unlock() { lock.Unlock(node); }
+    };
+
+    /*
+     * Contend runs num_threads threads that each increment a shared
+     * counter iterations times under lock, and returns the elapsed seconds.
+     */
+    template <typename Mutex>
+    double Contend(Mutex& lock, int num_threads, unsigned int iterations)
+    {
+        unsigned int counter = 0;
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < num_threads; ++i)
+        {
+            threads.emplace_back([&]
+                {
+                    Locker<Mutex> locker{lock};
+                    for (unsigned int j = 0; j < iterations; ++j)
+                    {
+                        locker.Lock();
+                        ++counter;
+                        locker.Unlock();
+                    }
+                });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        CHECK_EQUAL(num_threads * iterations, counter);
+        CHECK_FALSE(lock.IsLocked());
+        return elapsed.count();
+    }
+
+    const unsigned int kContendCount = 20000;
+}
+
+TEST(TicketLock, MultiThread)
+{
+    Contend(m, 2, kContendCount);
+    const auto& stats = m.Stats().Stats();
+    CHECK_EQUAL(2 * kContendCount, stats.acquisitions);
+    CHECK_TRUE(stats.contended <= stats.acquisitions);
+    CHECK_TRUE(stats.max_hold_cycles > 0);
+}
+
+TEST(McsLock, MultiThread)
+{
+    Contend(m, 2, kContendCount);
+    CHECK_EQUAL(2 * kContendCount, m.Stats().Stats().acquisitions);
+}
+
+namespace
+{
+    template <typename Mutex>
+    void Scale(const char* name, int max_threads)
+    {
+        for (int n = 1; n <= max_threads; n *= 2)
+        {
+            Mutex lock;
+            const auto seconds = Contend(lock, n, kContendCount);
+            const auto& stats = lock.Stats().Stats();
+            printf("\n%-13s %2d threads: %6.1f Mops/s, %5.1f%% contended, "
+                   "%6.1f spins/op",
+                name, n, n * kContendCount / seconds / 1e6,
+                100.0 * stats.contended / stats.acquisitions,
+                static_cast<double>(stats.spins) / stats.acquisitions);
+        }
+    }
+}
+
+TEST(Mutex, Scaling)
+{
+    // FIFO locks hand over to preempted waiters when oversubscribed
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    Scale<bitnos::SpinLockMutex>("SpinLockMutex", max_threads);
+    Scale<bitnos::TicketLock>("TicketLock", max_threads);
+    Scale<bitnos::McsLock>("McsLock", max_threads);
+    printf("\n");
+}
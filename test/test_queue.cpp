@@ -1,4 +1,9 @@
 #include <CppUTest/CommandLineTestRunner.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "queue.hpp"
 
 using namespace bitnos;
@@ -54,6 +59,273 @@ TEST(QueueBasic, Pop)
     CHECK_EQUAL(0, q.Count());
 }
 
+TEST(QueueBasic, PushNPopN)
+{
+    int in[] = {1, 2, 3, 4, 5, 6, 7};
+    int out[8];
+
+    CHECK_EQUAL(3, q.PushN(in, 3));
+    CHECK_EQUAL(2, q.PopN(out, 2));
+    CHECK_EQUAL(1, out[0]);
+    CHECK_EQUAL(2, out[1]);
+
+    // wraps around and stops when full
+    CHECK_EQUAL(4, q.PushN(in + 3, 4));
+    CHECK_EQUAL(0, q.PushN(in, 1));
+    CHECK_EQUAL(5, q.Count());
+    CHECK_EQUAL(3, q.Front());
+
+    CHECK_EQUAL(5, q.PopN(out, 8));
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK_EQUAL(3 + i, out[i]);
+    }
+    CHECK_EQUAL(0, q.Count());
+    CHECK_EQUAL(0, q.PopN(out, 8));
+}
+
+TEST_GROUP(SpscQueue) {
+    bitnos::SpscQueue<int, 4> q;
+
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(SpscQueue, PushPopWrap)
+{
+    CHECK_EQUAL(errorcode::kEmpty, q.Pop());
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            CHECK_EQUAL(errorcode::kSuccess, q.Push(10 * round + i));
+        }
+        CHECK_EQUAL(errorcode::kFull, q.Push(99));
+        CHECK_EQUAL(4, q.Count());
+
+        for (int i = 0; i < 4; ++i)
+        {
+            CHECK_EQUAL(10 * round + i, q.Front());
+            CHECK_EQUAL(errorcode::kSuccess, q.Pop());
+        }
+        CHECK_EQUAL(0, q.Count());
+        CHECK_EQUAL(errorcode::kEmpty, q.Pop());
+    }
+}
+
+TEST(SpscQueue, TwoThreads)
+{
+    const unsigned int kNumValues = 1000000;
+    static bitnos::SpscQueue<unsigned int, 64> ring;
+
+    std::thread producer([&]
+        {
+            for (unsigned int i = 0; i < kNumValues; )
+            {
+                if (IsError(ring.Push(i)))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                ++i;
+            }
+        });
+
+    // every value arrives exactly once and in order
+    unsigned int expected = 0;
+    while (expected < kNumValues)
+    {
+        if (ring.Count() == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        CHECK_EQUAL(expected, ring.Front());
+        CHECK_EQUAL(errorcode::kSuccess, ring.Pop());
+        ++expected;
+    }
+    producer.join();
+    CHECK_EQUAL(0, ring.Count());
+}
+
+TEST_GROUP(MpmcQueue) {
+    bitnos::MpmcQueue<int, 4> q;
+
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(MpmcQueue, Basic)
+{
+    int value;
+    CHECK_EQUAL(errorcode::kEmpty, q.Pop(value));
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            CHECK_EQUAL(errorcode::kSuccess, q.Push(10 * round + i));
+        }
+        CHECK_EQUAL(errorcode::kFull, q.Push(99));
+        CHECK_EQUAL(4, q.Count());
+        for (int i = 0; i < 4; ++i)
+        {
+            CHECK_EQUAL(errorcode::kSuccess, q.Pop(value));
+            CHECK_EQUAL(10 * round + i, value);
+        }
+        CHECK_EQUAL(errorcode::kEmpty, q.Pop(value));
+    }
+}
+
+TEST(MpmcQueue, PushNPopN)
+{
+    int in[] = {1, 2, 3, 4, 5, 6};
+    int out[8];
+
+    CHECK_EQUAL(3, q.PushN(in, 3));
+    CHECK_EQUAL(1, q.PushN(in + 3, 3));
+    CHECK_EQUAL(0, q.PushN(in + 4, 2));
+    CHECK_EQUAL(2, q.PopN(out, 2));
+    CHECK_EQUAL(2, q.PushN(in + 4, 2));
+    CHECK_EQUAL(4, q.PopN(out + 2, 8));
+    for (int i = 0; i < 6; ++i)
+    {
+        CHECK_EQUAL(i + 1, out[i]);
+    }
+    CHECK_EQUAL(0, q.PopN(out, 8));
+}
+
+namespace
+{
+    const int kNumProducers = 4;
+    const int kNumConsumers = 4;
+    const uint64_t kValuesPerProducer = 200000;
+
+    bitnos::MpmcQueue<uint64_t, 256> mpmc;
+
+    /*
+     * RunMpmc moves values tagged with their producer through mpmc in
+     * batches of up to `batch` and returns the elapsed seconds.
+     * With check set, every consumer verifies that each producer's values
+     * arrive in order and all of them arrive exactly once.
+     */
+    double RunMpmc(int num_producers, int num_consumers, size_t batch, bool check)
+    {
+        std::atomic<uint64_t> num_popped{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<bool> order_ok{true};
+        const uint64_t total = num_producers * kValuesPerProducer;
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int p = 0; p < num_producers; ++p)
+        {
+            threads.emplace_back([=]
+                {
+                    uint64_t buf[64];
+                    for (uint64_t i = 0; i < kValuesPerProducer; )
+                    {
+                        size_t n = 0;
+                        for (; n < batch && i + n < kValuesPerProducer; ++n)
+                        {
+                            buf[n] = static_cast<uint64_t>(p) << 32 | (i + n);
+                        }
+                        const auto pushed = mpmc.PushN(buf, n);
+                        if (pushed == 0)
+                        {
+                            std::this_thread::yield();
+                        }
+                        i += pushed;
+                    }
+                });
+        }
+        for (int c = 0; c < num_consumers; ++c)
+        {
+            threads.emplace_back([&, batch, check]
+                {
+                    uint64_t buf[64];
+                    int64_t last[kNumProducers];
+                    for (auto& l : last)
+                    {
+                        l = -1;
+                    }
+                    while (num_popped.load() < total)
+                    {
+                        const auto n = mpmc.PopN(buf, batch);
+                        if (n == 0)
+                        {
+                            std::this_thread::yield();
+                            continue;
+                        }
+                        num_popped += n;
+                        if (!check)
+                        {
+                            continue;
+                        }
+                        for (size_t i = 0; i < n; ++i)
+                        {
+                            const auto p = buf[i] >> 32;
+                            const int64_t seq = buf[i] & 0xffffffffu;
+                            if (seq <= last[p])
+                            {
+                                order_ok = false;
+                            }
+                            last[p] = seq;
+                            sum += seq;
+                        }
+                    }
+                });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        CHECK_EQUAL(total, num_popped.load());
+        CHECK_EQUAL(0, mpmc.Count());
+        if (check)
+        {
+            CHECK_TRUE(order_ok.load());
+            CHECK_EQUAL(num_producers * (kValuesPerProducer * (kValuesPerProducer - 1) / 2),
+                        sum.load());
+        }
+        return elapsed.count();
+    }
+}
+
+TEST(MpmcQueue, StressSingle)
+{
+    RunMpmc(kNumProducers, kNumConsumers, 1, true);
+}
+
+TEST(MpmcQueue, StressBatched)
+{
+    RunMpmc(kNumProducers, kNumConsumers, 16, true);
+}
+
+TEST(MpmcQueue, Throughput)
+{
+    const int configs[][2] = {{1, 1}, {2, 2}, {kNumProducers, kNumConsumers}};
+    for (auto& config : configs)
+    {
+        for (size_t batch : {1, 16})
+        {
+            const auto seconds = RunMpmc(config[0], config[1], batch, false);
+            printf("\nmpmc %dP%dC batch %2zu: %6.1f Mops/s",
+                config[0], config[1], batch,
+                config[0] * kValuesPerProducer / seconds / 1e6);
+        }
+    }
+    printf("\n");
+}
+
 int main(int argc, char** argv)
 {
     return RUN_ALL_TESTS(argc, argv);
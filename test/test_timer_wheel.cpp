@@ -0,0 +1,154 @@
+#include <CppUTest/CommandLineTestRunner.h>
+#include <stdlib.h>
+#include <vector>
+#include "timer_wheel.hpp"
+
+using bitnos::timer::Timer;
+using bitnos::timer::TimerWheel;
+
+namespace
+{
+    TimerWheel* current_wheel;
+    std::vector<std::pair<Timer*, uint64_t>> fired; // timer and tick it fired
+
+    void Record(Timer& timer)
+    {
+        fired.push_back({&timer, current_wheel->Now()});
+    }
+
+    void Set(Timer& timer, uint64_t expires)
+    {
+        timer = Timer{};
+        timer.callback = Record;
+        timer.expires = expires;
+    }
+}
+
+TEST_GROUP(TimerWheel) {
+    TimerWheel* wheel;
+
+    TEST_SETUP()
+    {
+        wheel = new TimerWheel(1000);
+        current_wheel = wheel;
+        fired.clear();
+    }
+
+    TEST_TEARDOWN()
+    {
+        delete wheel;
+    }
+};
+
+TEST(TimerWheel, Empty)
+{
+    CHECK_EQUAL(TimerWheel::kNoEvent, wheel->NextEvent());
+    wheel->Advance(5000);
+    CHECK_EQUAL(5000, wheel->Now());
+    CHECK(fired.empty());
+}
+
+TEST(TimerWheel, FiresAtExpiryInOrder)
+{
+    const uint64_t expires[] = {1000 + 70000, 1001, 1063, 1064, 1000 + 4096, 1005};
+    Timer timers[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        Set(timers[i], expires[i]);
+        wheel->Add(timers[i]);
+    }
+
+    wheel->Advance(1000 + 100000);
+    CHECK_EQUAL(6, fired.size());
+    uint64_t last = 0;
+    for (auto& f : fired)
+    {
+        CHECK_EQUAL(f.first->expires, f.second);
+        CHECK(last <= f.second);
+        CHECK_FALSE(f.first->pending);
+        last = f.second;
+    }
+}
+
+TEST(TimerWheel, PastExpiryFiresNextTick)
+{
+    Timer t;
+    Set(t, 10);
+    wheel->Add(t);
+    CHECK_EQUAL(1001, wheel->NextEvent());
+    wheel->Advance(1000);
+    CHECK(fired.empty());
+    wheel->Advance(1001);
+    CHECK_EQUAL(1, fired.size());
+}
+
+TEST(TimerWheel, Cancel)
+{
+    Timer a, b;
+    Set(a, 2000);
+    Set(b, 3000);
+    wheel->Add(a);
+    wheel->Add(b);
+    wheel->Cancel(a);
+    CHECK_FALSE(a.pending);
+    wheel->Advance(5000);
+    CHECK_EQUAL(1, fired.size());
+    POINTERS_EQUAL(&b, fired[0].first);
+    CHECK_EQUAL(TimerWheel::kNoEvent, wheel->NextEvent());
+}
+
+TEST(TimerWheel, BeyondTopLevel)
+{
+    const uint64_t far = 1000 + 3 * (uint64_t{1} << 24) + 12345;
+    Timer t;
+    Set(t, far);
+    wheel->Add(t);
+    wheel->Advance(far - 1);
+    CHECK(fired.empty());
+    wheel->Advance(far);
+    CHECK_EQUAL(1, fired.size());
+    CHECK_EQUAL(far, fired[0].second);
+}
+
+TEST(TimerWheel, Random)
+{
+    const int kNumTimers = 200;
+    Timer timers[kNumTimers];
+    for (auto& t : timers)
+    {
+        Set(t, 0);
+    }
+
+    srand(1);
+    uint64_t now = wheel->Now();
+    for (int round = 0; round < 2000; ++round)
+    {
+        auto& t = timers[rand() % kNumTimers];
+        switch (rand() % 3)
+        {
+        case 0:
+            t.expires = now + 1 + rand() % (1 << (rand() % 22));
+            wheel->Add(t);
+            break;
+        case 1:
+            wheel->Cancel(t);
+            break;
+        default:
+            {
+                fired.clear();
+                const uint64_t to = now + rand() % (1 << (rand() % 16));
+                wheel->Advance(to);
+                for (auto& f : fired)
+                {
+                    CHECK_EQUAL(f.first->expires, f.second);
+                    CHECK(now < f.second && f.second <= to);
+                }
+                for (auto& timer : timers)
+                {
+                    CHECK(!timer.pending || timer.expires > to);
+                }
+                now = to;
+            }
+        }
+    }
+}
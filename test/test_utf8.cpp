@@ -0,0 +1,82 @@
+#include <CppUTest/CommandLineTestRunner.h>
+#include <string.h>
+#include "utf8.hpp"
+
+namespace
+{
+    using bitnos::utf8::kReplacementCharacter;
+
+    /** Decode feeds s to a fresh decoder and returns the number of code points. */
+    int Decode(const char* s, char32_t* out)
+    {
+        bitnos::utf8::Decoder decoder;
+        int n = 0;
+        for (size_t i = 0; i < strlen(s); ++i)
+        {
+            n += decoder.Feed(s[i], out + n);
+        }
+        return n;
+    }
+}
+
+TEST_GROUP(Utf8) {
+    char32_t out[16];
+
+    TEST_SETUP()
+    {}
+
+    TEST_TEARDOWN()
+    {}
+};
+
+TEST(Utf8, ascii)
+{
+    CHECK_EQUAL(2, Decode("a\n", out));
+    CHECK_EQUAL(U'a', out[0]);
+    CHECK_EQUAL(U'\n', out[1]);
+}
+
+TEST(Utf8, multibyte)
+{
+    // U+00E9, U+3042 (hiragana a), U+1F600
+    CHECK_EQUAL(3, Decode("\xc3\xa9\xe3\x81\x82\xf0\x9f\x98\x80", out));
+    CHECK_EQUAL(0xe9u, out[0]);
+    CHECK_EQUAL(0x3042u, out[1]);
+    CHECK_EQUAL(0x1f600u, out[2]);
+}
+
+TEST(Utf8, split_across_feeds)
+{
+    bitnos::utf8::Decoder decoder;
+    CHECK_EQUAL(0, decoder.Feed(0xe6, out));
+    CHECK_EQUAL(0, decoder.Feed(0x97, out));
+    CHECK_EQUAL(1, decoder.Feed(0xa5, out));
+    CHECK_EQUAL(0x65e5u, out[0]);
+}
+
+TEST(Utf8, malformed)
+{
+    // stray continuation, then overlong '/' (an invalid lead byte and
+    // another stray continuation)
+    CHECK_EQUAL(3, Decode("\x80\xc0\xaf", out));
+    CHECK_EQUAL(kReplacementCharacter, out[0]);
+    CHECK_EQUAL(kReplacementCharacter, out[1]);
+    CHECK_EQUAL(kReplacementCharacter, out[2]);
+
+    // overlong U+0000, a surrogate and a value beyond U+10FFFF
+    CHECK_EQUAL(1, Decode("\xe0\x80\x80", out));
+    CHECK_EQUAL(kReplacementCharacter, out[0]);
+
+    CHECK_EQUAL(1, Decode("\xed\xa0\x80", out));
+    CHECK_EQUAL(kReplacementCharacter, out[0]);
+
+    CHECK_EQUAL(1, Decode("\xf4\x90\x80\x80", out));
+    CHECK_EQUAL(kReplacementCharacter, out[0]);
+}
+
+TEST(Utf8, truncated_sequence_keeps_next_char)
+{
+    CHECK_EQUAL(2, Decode("\xe3\x81" "a", out));
+    CHECK_EQUAL(kReplacementCharacter, out[0]);
+    CHECK_EQUAL(U'a', out[1]);
+}
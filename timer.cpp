@@ -0,0 +1,342 @@
+#include "timer.hpp"
+
+#include "acpi.hpp"
+#include "apic.hpp"
+#include "asmfunc.h"
+#include "interrupt.hpp"
+#include "memory.hpp"
+#include "mutex.hpp"
+#include "paging.hpp"
+
+namespace
+{
+    using namespace bitnos;
+    using namespace bitnos::timer;
+
+    const uint64_t kNsPerSecond = 1000000000;
+    const uint64_t kCalibrationNs = 10000000; // 10 ms
+    // calibration gives up after this, far longer than 10 ms at any CPU
+    // clock, so that a stuck counter or a missing PIT cannot hang boot
+    const uint64_t kCalibrationMaxCycles = 1000000000;
+
+    // HPET registers
+    const uintptr_t kHpetCapabilities = 0x000;
+    const uintptr_t kHpetConfig = 0x010;
+    const uintptr_t kHpetMainCounter = 0x0f0;
+    const uint64_t kHpetEnable = 1;
+    const uint64_t kHpetCounter64 = 1u << 13; // COUNT_SIZE_CAP
+    const uint64_t kHpetMaxPeriodFs = 100000000; // 100 ns, as the spec allows
+
+    // PIT channel 2 is gated through port 0x61 and can be polled there
+    const uint64_t kPitHz = 1193182;
+    const uint16_t kPitCount = kPitHz * kCalibrationNs / kNsPerSecond;
+    const uint16_t kPitChannel2 = 0x42;
+    const uint16_t kPitCommand = 0x43;
+    const uint16_t kPitGatePort = 0x61;
+    const uint8_t kPitGate = 0x01;
+    const uint8_t kPitSpeaker = 0x02;
+    const uint8_t kPitOut = 0x20;
+
+    const uint32_t kMsrTscDeadline = 0x6e0;
+    const uint32_t kLvtTscDeadline = 2u << 17;
+    const uint32_t kLapicDivideBy1 = 0xb;
+
+    ClockSource source = ClockSource::kNone;
+    TimerDevice device = TimerDevice::kNone;
+    bool invariant_tsc = false;
+    uint64_t tsc_hz = 0;
+    uint64_t tsc_base = 0;
+    uint64_t ns_mult = 0;    // ns = tsc * ns_mult >> 32
+    uint64_t tsc_mult = 0;   // tsc = ns * tsc_mult >> 32
+    uint64_t lapic_mult = 0; // lapic counts = tsc * lapic_mult >> 32
+
+    char wheel_buf[sizeof(TimerWheel)]
+        __attribute__((aligned(alignof(TimerWheel))));
+    TimerWheel* wheel = nullptr;
+    uint64_t programmed_tick = TimerWheel::kNoEvent;
+    uint64_t armed_tick = 0; // tick the device fires at, 0 if earlier
+
+    uint64_t MulShift32(uint64_t a, uint64_t b)
+    {
+        return static_cast<unsigned __int128>(a) * b >> 32;
+    }
+
+    uint64_t ReadHpet(uintptr_t base, uintptr_t reg)
+    {
+        return *reinterpret_cast<volatile uint64_t*>(base + reg);
+    }
+
+    void WriteHpet(uintptr_t base, uintptr_t reg, uint64_t value)
+    {
+        *reinterpret_cast<volatile uint64_t*>(base + reg) = value;
+    }
+
+    /*
+     * CalibrateWithHpet returns the TSC frequency, or 0 if there is no
+     * usable HPET or its counter does not advance.
+     */
+    uint64_t CalibrateWithHpet()
+    {
+        auto hpet = reinterpret_cast<const acpi::HPET*>(acpi::FindTable("HPET"));
+        if (hpet == nullptr || hpet->base_address.space_id != 0)
+        {
+            return 0;
+        }
+        const uintptr_t base = hpet->base_address.address;
+        if (IsError(paging::MapMmio(base, 0x400)))
+        {
+            return 0;
+        }
+
+        const auto capabilities = ReadHpet(base, kHpetCapabilities);
+        const uint64_t period_fs = capabilities >> 32;
+        if (period_fs == 0 || period_fs > kHpetMaxPeriodFs)
+        {
+            return 0;
+        }
+        const uint64_t counter_mask =
+            capabilities & kHpetCounter64 ? UINT64_MAX : UINT32_MAX;
+        WriteHpet(base, kHpetConfig, ReadHpet(base, kHpetConfig) | kHpetEnable);
+
+        const uint64_t wait = kCalibrationNs * 1000000 / period_fs;
+        const auto h0 = ReadHpet(base, kHpetMainCounter);
+        const auto t0 = ReadTSC();
+        uint64_t ticks, t1;
+        do
+        {
+            ticks = (ReadHpet(base, kHpetMainCounter) - h0) & counter_mask;
+            t1 = ReadTSC();
+            if (t1 - t0 > kCalibrationMaxCycles)
+            {
+                return 0;
+            }
+        } while (ticks < wait);
+
+        const uint64_t elapsed_ns = ticks * period_fs / 1000000;
+        return (t1 - t0) * kNsPerSecond / elapsed_ns;
+    }
+
+    uint64_t CalibrateWithPit()
+    {
+        // load the count with the gate low, then start counting
+        const uint8_t port61 = IoIn8(kPitGatePort) & ~(kPitGate | kPitSpeaker);
+        IoOut8(kPitGatePort, port61);
+        IoOut8(kPitCommand, 0xb0); // channel 2, low then high byte, mode 0
+        IoOut8(kPitChannel2, kPitCount & 0xffu);
+        IoOut8(kPitChannel2, kPitCount >> 8);
+
+        IoOut8(kPitGatePort, port61 | kPitGate);
+        const auto t0 = ReadTSC();
+        uint64_t t1;
+        bool out;
+        do
+        {
+            out = IoIn8(kPitGatePort) & kPitOut;
+            t1 = ReadTSC();
+        } while (!out && t1 - t0 <= kCalibrationMaxCycles);
+        IoOut8(kPitGatePort, port61);
+
+        if (!out)
+        {
+            return 0; // no PIT
+        }
+        return (t1 - t0) * kPitHz / kPitCount;
+    }
+
+    uint64_t CalibrateLapic()
+    {
+        apic::WriteLapic(apic::kLapicDivideConfig, kLapicDivideBy1);
+        apic::WriteLapic(apic::kLapicLvtTimer, apic::kLvtMasked);
+        apic::WriteLapic(apic::kLapicInitialCount, UINT32_MAX);
+        const auto t0 = ReadTSC();
+        while (ReadTSC() - t0 < MulShift32(kCalibrationNs, tsc_mult));
+        const auto count = UINT32_MAX - apic::ReadLapic(apic::kLapicCurrentCount);
+        const auto t1 = ReadTSC();
+        apic::WriteLapic(apic::kLapicInitialCount, 0);
+
+        return count * tsc_hz / (t1 - t0);
+    }
+
+    void Program(uint64_t tick)
+    {
+        programmed_tick = tick;
+        armed_tick = 0;
+        if (tick == TimerWheel::kNoEvent)
+        {
+            if (device == TimerDevice::kTscDeadline)
+            {
+                WriteMSR(kMsrTscDeadline, 0);
+            }
+            else
+            {
+                apic::WriteLapic(apic::kLapicInitialCount, 0);
+            }
+            return;
+        }
+
+        const auto deadline = tsc_base + MulShift32(tick << kTickShift, tsc_mult);
+        if (device == TimerDevice::kTscDeadline)
+        {
+            // a deadline in the past fires at once; 0 would disarm
+            WriteMSR(kMsrTscDeadline, deadline == 0 ? 1 : deadline);
+            armed_tick = tick;
+            return;
+        }
+
+        const auto now = ReadTSC();
+        uint64_t count = deadline > now ? MulShift32(deadline - now, lapic_mult) + 1 : 1;
+        if (count > UINT32_MAX)
+        {
+            // fires early, then the rest is programmed
+            count = UINT32_MAX;
+        }
+        else
+        {
+            armed_tick = tick;
+        }
+        apic::WriteLapic(apic::kLapicInitialCount, count);
+    }
+
+    void Reprogram()
+    {
+        const auto next = wheel->NextEvent();
+        if (next != programmed_tick)
+        {
+            Program(next);
+        }
+    }
+
+    void OnTimer(interrupt::InterruptFrame& frame)
+    {
+        apic::EndOfInterrupt();
+
+        // the device has reached armed_tick even if rounding says otherwise
+        const auto now = NowNs() >> kTickShift;
+        wheel->Advance(now > armed_tick ? now : armed_tick);
+
+        programmed_tick = 0; // the device is idle now
+        Reprogram();
+    }
+}
+
+namespace bitnos::timer
+{
+    Error InitializeClock()
+    {
+        uint32_t regs[4];
+        CpuId(0x80000000, 0, regs);
+        if (regs[0] >= 0x80000007)
+        {
+            CpuId(0x80000007, 0, regs);
+            invariant_tsc = regs[3] & (1u << 8);
+        }
+
+        const auto flags = SaveAndDisableInterrupts();
+        auto hz = CalibrateWithHpet();
+        source = ClockSource::kHpet;
+        if (hz == 0)
+        {
+            hz = CalibrateWithPit();
+            source = ClockSource::kPit;
+        }
+        RestoreInterrupts(flags);
+
+        if (hz == 0)
+        {
+            source = ClockSource::kNone;
+            return errorcode::kNotFound;
+        }
+
+        tsc_hz = hz;
+        tsc_mult = (hz / kNsPerSecond << 32) + ((hz % kNsPerSecond) << 32) / kNsPerSecond;
+        tsc_base = ReadTSC();
+        ns_mult = (kNsPerSecond << 32) / hz;
+        return errorcode::kSuccess;
+    }
+
+    Error InitializeTimer()
+    {
+        if (tsc_hz == 0 || apic::LapicMode() == apic::Mode::kDisabled)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        wheel = new(wheel_buf) TimerWheel(NowNs() >> kTickShift);
+        interrupt::SetHandler(kTimerVector, OnTimer, true);
+
+        uint32_t regs[4];
+        CpuId(1, 0, regs);
+        if (regs[2] & (1u << 24))
+        {
+            device = TimerDevice::kTscDeadline;
+            apic::WriteLapic(apic::kLapicLvtTimer, kLvtTscDeadline | kTimerVector);
+        }
+        else
+        {
+            const auto flags = SaveAndDisableInterrupts();
+            const auto lapic_hz = CalibrateLapic();
+            RestoreInterrupts(flags);
+            if (lapic_hz == 0)
+            {
+                return errorcode::kNotFound;
+            }
+            lapic_mult = (lapic_hz << 32) / tsc_hz;
+            device = TimerDevice::kLapicOneShot;
+            apic::WriteLapic(apic::kLapicLvtTimer, kTimerVector); // one-shot
+        }
+        return errorcode::kSuccess;
+    }
+
+    ClockSource Source()
+    {
+        return source;
+    }
+
+    TimerDevice Device()
+    {
+        return device;
+    }
+
+    uint64_t TscFrequency()
+    {
+        return tsc_hz;
+    }
+
+    bool InvariantTsc()
+    {
+        return invariant_tsc;
+    }
+
+    uint64_t NowNs()
+    {
+        return MulShift32(ReadTSC() - tsc_base, ns_mult);
+    }
+
+    Error Start(Timer& timer, uint64_t deadline_ns)
+    {
+        if (wheel == nullptr)
+        {
+            return errorcode::kInvalidValue;
+        }
+
+        timer.expires = (deadline_ns + (1u << kTickShift) - 1) >> kTickShift;
+        const auto flags = SaveAndDisableInterrupts();
+        wheel->Add(timer);
+        Reprogram();
+        RestoreInterrupts(flags);
+        return errorcode::kSuccess;
+    }
+
+    void Cancel(Timer& timer)
+    {
+        if (wheel == nullptr)
+        {
+            return;
+        }
+
+        const auto flags = SaveAndDisableInterrupts();
+        wheel->Cancel(timer);
+        Reprogram();
+        RestoreInterrupts(flags);
+    }
+}
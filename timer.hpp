@@ -0,0 +1,94 @@
+#ifndef TIMER_HPP_
+#define TIMER_HPP_
+
+/** @file timer.hpp provides the monotonic clock and one-shot timers.
+ *
+ * The TSC is calibrated against the HPET, or the PIT if there is none.
+ * Timers are kept in a TimerWheel and the earliest one arms a one-shot
+ * TSC-deadline or LAPIC timer, so there is no periodic tick.
+ */
+
+#include <stdint.h>
+
+#include "errorcode.hpp"
+#include "timer_wheel.hpp"
+
+namespace bitnos::timer
+{
+    /** Timer ticks are 2^16 ns (about 65.5 us). */
+    const int kTickShift = 16;
+    const uint8_t kTimerVector = 0x40;
+
+    enum class ClockSource
+    {
+        kNone,
+        kHpet,
+        kPit,
+    };
+
+    enum class TimerDevice
+    {
+        kNone,
+        kTscDeadline,
+        kLapicOneShot,
+    };
+
+    /** @brief InitializeClock calibrates the TSC. NowNs counts from here.
+     * acpi::Initialize should be called in advance to find the HPET.
+     */
+    Error InitializeClock();
+
+    /** @brief InitializeTimer sets up the one-shot timer.
+     * The clock and apic::Initialize must succeed in advance.
+     */
+    Error InitializeTimer();
+
+    ClockSource Source();
+    TimerDevice Device();
+    uint64_t TscFrequency();
+
+    /** @brief InvariantTsc returns true if the TSC runs at a constant rate
+     * in all power states.
+     */
+    bool InvariantTsc();
+
+    /** @brief NowNs returns nanoseconds since InitializeClock, or 0 before.
+     */
+    uint64_t NowNs();
+
+    /** @brief Start calls timer.callback in interrupt context once
+     * NowNs() >= deadline_ns, rounded up to a tick.
+     *
+     * The callback runs with SSE state saved. timer must be zero
+     * initialized before its first use.
+     *
+     * @return kInvalidValue if InitializeTimer hasn't succeeded.
+     */
+    Error Start(Timer& timer, uint64_t deadline_ns);
+
+    /** @brief Cancel stops timer if it has not fired yet.
+     */
+    void Cancel(Timer& timer);
+
+    /** @brief PollUntil busy-waits until cond() returns true.
+     *
+     * @return false if timeout_ns passed first. Without a calibrated
+     *   clock it waits as long as it takes.
+     */
+    template <typename Cond>
+    bool PollUntil(Cond cond, uint64_t timeout_ns)
+    {
+        const bool has_clock = TscFrequency() != 0;
+        const auto deadline = NowNs() + timeout_ns;
+        while (!cond())
+        {
+            if (has_clock && NowNs() >= deadline)
+            {
+                return cond();
+            }
+        }
+        return true;
+    }
+}
+
+#endif // TIMER_HPP_
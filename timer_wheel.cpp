@@ -0,0 +1,166 @@
+#include "timer_wheel.hpp"
+
+namespace
+{
+    using bitnos::timer::TimerWheel;
+
+    const uint64_t kSlotMask = TimerWheel::kSlotsPerLevel - 1;
+    const uint64_t kMaxDistance =
+        uint64_t{1} << (TimerWheel::kBitsPerLevel * TimerWheel::kNumLevels);
+
+    int Shift(int level)
+    {
+        return TimerWheel::kBitsPerLevel * level;
+    }
+
+    uint64_t RotateRight(uint64_t x, unsigned int bits)
+    {
+        bits &= 63;
+        return bits == 0 ? x : x >> bits | x << (64 - bits);
+    }
+}
+
+namespace bitnos::timer
+{
+    TimerWheel::TimerWheel(uint64_t now)
+        : slots_{}, occupied_{}, now_(now)
+    {}
+
+    void TimerWheel::Add(Timer& timer)
+    {
+        if (timer.pending)
+        {
+            Unlink(timer);
+        }
+        Place(timer, now_ + 1);
+    }
+
+    void TimerWheel::Cancel(Timer& timer)
+    {
+        if (timer.pending)
+        {
+            Unlink(timer);
+        }
+    }
+
+    void TimerWheel::Advance(uint64_t now)
+    {
+        for (;;)
+        {
+            const auto tick = NextEvent();
+            if (tick == kNoEvent || tick > now)
+            {
+                break;
+            }
+            now_ = tick;
+
+            // upper levels first: their timers may land in lower slots due now
+            for (int level = kNumLevels - 1; level > 0; --level)
+            {
+                if ((tick & ((uint64_t{1} << Shift(level)) - 1)) == 0)
+                {
+                    Cascade(level, (tick >> Shift(level)) & kSlotMask);
+                }
+            }
+
+            auto& head = slots_[0][tick & kSlotMask];
+            while (head)
+            {
+                auto timer = head;
+                Unlink(*timer);
+                timer->callback(*timer);
+            }
+        }
+
+        if (now > now_)
+        {
+            now_ = now;
+        }
+    }
+
+    uint64_t TimerWheel::NextEvent() const
+    {
+        uint64_t next = kNoEvent;
+        for (int level = 0; level < kNumLevels; ++level)
+        {
+            if (occupied_[level] == 0)
+            {
+                continue;
+            }
+
+            // slots hold the 64 blocks after the current one, in ring order
+            const auto block = (now_ >> Shift(level)) + 1;
+            const auto k = __builtin_ctzll(RotateRight(occupied_[level], block & kSlotMask));
+            const auto tick = (block + k) << Shift(level);
+            if (tick < next)
+            {
+                next = tick;
+            }
+        }
+        return next;
+    }
+
+    void TimerWheel::Place(Timer& timer, uint64_t earliest)
+    {
+        auto expires = timer.expires < earliest ? earliest : timer.expires;
+        if (expires - now_ >= kMaxDistance)
+        {
+            expires = now_ + kMaxDistance - 1;
+        }
+
+        int level = 0;
+        while (expires - now_ >= uint64_t{1} << Shift(level + 1))
+        {
+            ++level;
+        }
+        const int slot = (expires >> Shift(level)) & kSlotMask;
+
+        auto& head = slots_[level][slot];
+        timer.prev = nullptr;
+        timer.next = head;
+        if (head)
+        {
+            head->prev = &timer;
+        }
+        head = &timer;
+        occupied_[level] |= uint64_t{1} << slot;
+
+        timer.level = level;
+        timer.slot = slot;
+        timer.pending = true;
+    }
+
+    void TimerWheel::Unlink(Timer& timer)
+    {
+        auto& head = slots_[timer.level][timer.slot];
+        if (timer.prev)
+        {
+            timer.prev->next = timer.next;
+        }
+        else
+        {
+            head = timer.next;
+        }
+        if (timer.next)
+        {
+            timer.next->prev = timer.prev;
+        }
+        if (head == nullptr)
+        {
+            occupied_[timer.level] &= ~(uint64_t{1} << timer.slot);
+        }
+        timer.pending = false;
+    }
+
+    void TimerWheel::Cascade(int level, int slot)
+    {
+        auto& head = slots_[level][slot];
+        while (head)
+        {
+            auto timer = head;
+            Unlink(*timer);
+            // a timer due at the current tick goes to the slot fired next
+            Place(*timer, now_);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef TIMER_WHEEL_HPP_
+#define TIMER_WHEEL_HPP_
+
+/** @file timer_wheel.hpp provides a hierarchical timer wheel.
+ *
+ * Level L has 64 slots of 64^L ticks each. A timer goes to the lowest
+ * level whose span covers its distance from the current tick and moves
+ * down a level each time its slot comes due (cascading), so insert and
+ * cancel are O(1). Timers further than 64^4 ticks away wait in the top
+ * level and are re-placed until they fit.
+ *
+ * The wheel is tickless: NextEvent tells when Advance must be called
+ * next, which is either an expiry or a cascade.
+ */
+
+#include <stdint.h>
+
+namespace bitnos::timer
+{
+    struct Timer
+    {
+        using Callback = void (Timer& timer);
+
+        Callback* callback;
+        void* data;
+        uint64_t expires; // tick
+
+        // managed by TimerWheel
+        Timer* prev;
+        Timer* next;
+        uint8_t level, slot;
+        bool pending;
+    };
+
+    class TimerWheel
+    {
+    public:
+        static const int kBitsPerLevel = 6;
+        static const int kSlotsPerLevel = 1 << kBitsPerLevel;
+        static const int kNumLevels = 4;
+        static const uint64_t kNoEvent = UINT64_MAX;
+
+        explicit TimerWheel(uint64_t now);
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator =(const TimerWheel&) = delete;
+
+        /** @brief Add schedules timer at timer.expires.
+         * A timer not after the current tick expires at the next one.
+         */
+        void Add(Timer& timer);
+
+        /** @brief Cancel removes timer if it is pending.
+         */
+        void Cancel(Timer& timer);
+
+        /** @brief Advance moves the current tick to now and calls the
+         * callbacks of expired timers in expiry order.
+         *
+         * Callbacks may add and cancel timers.
+         */
+        void Advance(uint64_t now);
+
+        /** @brief NextEvent returns the first tick at which Advance has work,
+         * or kNoEvent if no timer is pending.
+         */
+        uint64_t NextEvent() const;
+
+        uint64_t Now() const { return now_; }
+
+    private:
+        Timer* slots_[kNumLevels][kSlotsPerLevel];
+        uint64_t occupied_[kNumLevels]; // bit per non-empty slot
+        uint64_t now_;
+
+        void Place(Timer& timer, uint64_t earliest);
+        void Unlink(Timer& timer);
+        void Cascade(int level, int slot);
+    };
+}
+
+#endif // TIMER_WHEEL_HPP_
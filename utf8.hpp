@@ -0,0 +1,98 @@
+#ifndef UTF8_HPP_
+#define UTF8_HPP_
+
+/** @file utf8.hpp provides a UTF-8 decoder for text output.
+ */
+
+#include <stdint.h>
+
+namespace bitnos::utf8
+{
+    const char32_t kReplacementCharacter = 0xfffd;
+
+    /** @brief Decoder converts a stream of bytes into code points.
+     *
+     * The state is kept between calls, so a character may be split across
+     * writes. Malformed or overlong sequences, surrogates and values above
+     * U+10FFFF become U+FFFD.
+     */
+    class Decoder
+    {
+        char32_t code_;
+        char32_t min_code_; // smallest code point the sequence may encode
+        int remaining_; // continuation bytes still expected
+
+        int Start(uint8_t byte, char32_t* out)
+        {
+            if (byte < 0x80u)
+            {
+                out[0] = byte;
+                return 1;
+            }
+            if (0xc2u <= byte && byte <= 0xdfu)
+            {
+                code_ = byte & 0x1fu;
+                min_code_ = 0x80;
+                remaining_ = 1;
+            }
+            else if (0xe0u <= byte && byte <= 0xefu)
+            {
+                code_ = byte & 0x0fu;
+                min_code_ = 0x800;
+                remaining_ = 2;
+            }
+            else if (0xf0u <= byte && byte <= 0xf4u)
+            {
+                code_ = byte & 0x07u;
+                min_code_ = 0x10000;
+                remaining_ = 3;
+            }
+            else
+            {
+                out[0] = kReplacementCharacter;
+                return 1;
+            }
+            return 0;
+        }
+
+    public:
+        Decoder()
+            : code_(0), min_code_(0), remaining_(0)
+        {}
+
+        /** @brief Feed decodes one more byte.
+         *
+         * @param byte  Next byte of the stream
+         * @param out  Array of at least 2 elements receiving code points
+         * @return Number of code points written to out
+         */
+        int Feed(uint8_t byte, char32_t* out)
+        {
+            if (remaining_ == 0)
+            {
+                return Start(byte, out);
+            }
+
+            if ((byte & 0xc0u) != 0x80u)
+            {
+                // the sequence is cut short; byte starts a new one
+                remaining_ = 0;
+                out[0] = kReplacementCharacter;
+                return 1 + Start(byte, out + 1);
+            }
+
+            code_ = (code_ << 6) | (byte & 0x3fu);
+            if (--remaining_ > 0)
+            {
+                return 0;
+            }
+
+            const bool surrogate = 0xd800 <= code_ && code_ <= 0xdfff;
+            out[0] = (code_ < min_code_ || code_ > 0x10ffff || surrogate)
+                ? kReplacementCharacter : code_;
+            return 1;
+        }
+    };
+}
+
+#endif // UTF8_HPP_
@@ -0,0 +1,105 @@
+#include "vbe.hpp"
+
+#include "asmfunc.h"
+#include "bitutil.hpp"
+#include "memory.hpp"
+#include "paging.hpp"
+#include "pci.hpp"
+
+namespace
+{
+    using namespace bitnos;
+
+    bool found = false;
+    pci::ScanCallbackParam device;
+}
+
+namespace bitnos::vbe
+{
+    uint16_t ReadDispi(DispiIndex index)
+    {
+        IoOut16(kDispiIndexPort, index);
+        return IoIn16(kDispiDataPort);
+    }
+
+    void WriteDispi(DispiIndex index, uint16_t value)
+    {
+        IoOut16(kDispiIndexPort, index);
+        IoOut16(kDispiDataPort, value);
+    }
+
+    WithError<Display*> Initialize(const GraphicMode& mode)
+    {
+        found = false;
+        pci::ScanAllBus([](const pci::ScanCallbackParam& param)
+            {
+                if (!found && param.vendor_id == kVendorId && param.device_id == kDeviceId)
+                {
+                    device = param;
+                    found = true;
+                }
+            });
+        if (!found)
+        {
+            return {nullptr, errorcode::kNotFound};
+        }
+
+        const auto id = ReadDispi(kDispiId);
+        if (id < kDispiIdMin || kDispiIdMax < id)
+        {
+            return {nullptr, errorcode::kNotFound};
+        }
+
+        // the GOP mode must be the one the device shows
+        if ((ReadDispi(kDispiEnable) & kDispiEnabled) == 0 ||
+            ReadDispi(kDispiBpp) != 32 ||
+            ReadDispi(kDispiXRes) != mode.horizontal_resolution ||
+            ReadDispi(kDispiYRes) != mode.vertical_resolution)
+        {
+            return {nullptr, errorcode::kNotFound};
+        }
+
+        pci::NormalDevice dev(device.bus, device.dev, device.func);
+        const auto bar = pci::ReadBar(dev, 0);
+        const auto bar_size = pci::CalcBarMapSize(dev, 0);
+        if (IsError(bar.error) || IsError(bar_size.error) ||
+            bitutil::ClearBits(bar.value, 0xf) != mode.frame_buffer_base)
+        {
+            return {nullptr, errorcode::kNotFound};
+        }
+
+        // the device derives the virtual height from the virtual width
+        // and its video memory size
+        WriteDispi(kDispiVirtWidth, mode.pixels_per_scan_line);
+        const size_t bytes_per_line = 4 * mode.pixels_per_scan_line;
+        unsigned int virtual_height = ReadDispi(kDispiVirtHeight);
+        if (virtual_height > bar_size.value / bytes_per_line)
+        {
+            virtual_height = bar_size.value / bytes_per_line;
+        }
+        if (virtual_height < 2 * mode.vertical_resolution)
+        {
+            return {nullptr, errorcode::kNotFound};
+        }
+
+        const size_t bytes = bitutil::ClearBits(
+            bytes_per_line * virtual_height + memory::kBytesPerFrame - 1,
+            memory::kBytesPerFrame - 1);
+        auto err = paging::MapPages(mode.frame_buffer_base, mode.frame_buffer_base,
+                                    bytes, paging::MemoryType::kWriteCombining);
+        if (IsError(err))
+        {
+            return {nullptr, err};
+        }
+
+        WriteDispi(kDispiXOffset, 0);
+        WriteDispi(kDispiYOffset, 0);
+
+        auto display = new Display(virtual_height);
+        if (display == nullptr)
+        {
+            return {nullptr, errorcode::kNoEnoughMemory};
+        }
+        return {display, errorcode::kSuccess};
+    }
+}
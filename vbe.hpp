@@ -0,0 +1,80 @@
+#ifndef VBE_HPP_
+#define VBE_HPP_
+
+/** @file vbe.hpp drives the display interface (DISPI) of the Bochs VBE
+ * extensions, which QEMU's "-vga std" also implements.
+ */
+
+#include <stdint.h>
+
+#include "bootparam.h"
+#include "errorcode.hpp"
+#include "graphics.hpp"
+
+namespace bitnos::vbe
+{
+    const uint16_t kVendorId = 0x1234;
+    const uint16_t kDeviceId = 0x1111;
+
+    const uint16_t kDispiIndexPort = 0x01ce;
+    const uint16_t kDispiDataPort = 0x01cf;
+
+    enum DispiIndex : uint16_t
+    {
+        kDispiId = 0,
+        kDispiXRes = 1,
+        kDispiYRes = 2,
+        kDispiBpp = 3,
+        kDispiEnable = 4,
+        kDispiBank = 5,
+        kDispiVirtWidth = 6,
+        kDispiVirtHeight = 7,
+        kDispiXOffset = 8,
+        kDispiYOffset = 9,
+    };
+
+    /** DISPI versions since which the virtual size and offsets work. */
+    const uint16_t kDispiIdMin = 0xb0c2;
+    const uint16_t kDispiIdMax = 0xb0c5;
+    const uint16_t kDispiEnabled = 0x01;
+
+    uint16_t ReadDispi(DispiIndex index);
+    void WriteDispi(DispiIndex index, uint16_t value);
+
+    /** @brief Display is the frame buffer of a Bochs display taller than
+     * the screen. Moving the visible window is one register write.
+     */
+    class Display : public graphics::ScrollableDisplay
+    {
+        const unsigned int virtual_height_;
+
+    public:
+        Display(unsigned int virtual_height)
+            : virtual_height_(virtual_height)
+        {}
+
+        unsigned int VirtualHeight() const override
+        {
+            return virtual_height_;
+        }
+
+        void SetYOffset(unsigned int y) override
+        {
+            WriteDispi(kDispiYOffset, y);
+        }
+    };
+
+    /** @brief Initialize looks for a Bochs display showing the GOP mode and
+     * extends its frame buffer to as many lines as the video memory holds.
+     *
+     * The extended frame buffer is mapped write-combining.
+     * At least twice the screen height is required so that one screen
+     * can be drawn while the other is shown.
+     *
+     * @param mode  Graphic mode set by the boot loader
+     * @return kNotFound if there is no usable device
+     */
+    WithError<Display*> Initialize(const GraphicMode& mode);
+}
+
+#endif // VBE_HPP_